@@ -27,15 +27,181 @@
  **************************************************************************/
 
 #include "Collection.h"
+#include "PrefetchCursor.h"
+
+#include <chrono>
+#include <thread>
+#include <unordered_map>
 
 namespace mongo {
 
-// ** Collection::Collection
-Collection::Collection( mongoc_collection_t* collection ) : m_collection( collection )
+// ** FindOptions::FindOptions
+FindOptions::FindOptions( void )
+    : m_projection( ( bson_t* )NULL ), m_sort( ( bson_t* )NULL ), m_hint( ( bson_t* )NULL )
+    , m_limit( 0 ), m_skip( 0 ), m_batchSize( 0 ), m_maxTimeMS( 0 ), m_noCursorTimeout( false )
+{
+
+}
+
+// ** FindOptions::projection
+FindOptions& FindOptions::projection( const BSON& fields )
+{
+    m_projection = fields;
+    return *this;
+}
+
+// ** FindOptions::limit
+FindOptions& FindOptions::limit( uint32_t value )
+{
+    m_limit = value;
+    return *this;
+}
+
+// ** FindOptions::skip
+FindOptions& FindOptions::skip( uint32_t value )
+{
+    m_skip = value;
+    return *this;
+}
+
+// ** FindOptions::sort
+FindOptions& FindOptions::sort( const BSON& order )
+{
+    m_sort = order;
+    return *this;
+}
+
+// ** FindOptions::batchSize
+FindOptions& FindOptions::batchSize( uint32_t value )
+{
+    m_batchSize = value;
+    return *this;
+}
+
+// ** FindOptions::hint
+FindOptions& FindOptions::hint( const BSON& index )
+{
+    m_hint = index;
+    return *this;
+}
+
+// ** FindOptions::hint
+FindOptions& FindOptions::hint( const std::string& index )
+{
+    m_hintName = index;
+    return *this;
+}
+
+// ** FindOptions::maxTimeMS
+FindOptions& FindOptions::maxTimeMS( uint32_t value )
+{
+    m_maxTimeMS = value;
+    return *this;
+}
+
+// ** FindOptions::noCursorTimeout
+FindOptions& FindOptions::noCursorTimeout( bool value )
+{
+    m_noCursorTimeout = value;
+    return *this;
+}
+
+// ** AggregateOptions::AggregateOptions
+AggregateOptions::AggregateOptions( void ) : m_batchSize( 0 ), m_maxTimeMS( 0 ), m_allowDiskUse( false )
+{
+
+}
+
+// ** AggregateOptions::allowDiskUse
+AggregateOptions& AggregateOptions::allowDiskUse( bool value )
+{
+    m_allowDiskUse = value;
+    return *this;
+}
+
+// ** AggregateOptions::batchSize
+AggregateOptions& AggregateOptions::batchSize( uint32_t value )
+{
+    m_batchSize = value;
+    return *this;
+}
+
+// ** AggregateOptions::maxTimeMS
+AggregateOptions& AggregateOptions::maxTimeMS( uint32_t value )
+{
+    m_maxTimeMS = value;
+    return *this;
+}
+
+//! Cached count results keyed by query bytes.
+struct Collection::CountCache {
+    //! Cached count.
+    struct Entry {
+        int64_t                                 count;      //!< Number of matching documents.
+        std::chrono::steady_clock::time_point   expires;    //!< Expiration time.
+    };
+
+    std::chrono::milliseconds                   ttl;        //!< Lifetime of a cached count.
+    size_t                                      maxEntries; //!< Maximum number of cached queries.
+    uint64_t                                    writes;     //!< Collection write counter the entries were cached at.
+    std::unordered_map<std::string, Entry>      entries;    //!< Cached counts.
+};
+
+// ** FindAndModifyOptions::FindAndModifyOptions
+FindAndModifyOptions::FindAndModifyOptions( void )
+    : m_sort( ( bson_t* )NULL ), m_update( ( bson_t* )NULL ), m_fields( ( bson_t* )NULL ), m_upsert( false ), m_remove( false ), m_returnNew( false )
 {
 
 }
 
+// ** FindAndModifyOptions::sort
+FindAndModifyOptions& FindAndModifyOptions::sort( const BSON& order )
+{
+    m_sort = order;
+    return *this;
+}
+
+// ** FindAndModifyOptions::update
+FindAndModifyOptions& FindAndModifyOptions::update( const BSON& value )
+{
+    m_update = value;
+    return *this;
+}
+
+// ** FindAndModifyOptions::upsert
+FindAndModifyOptions& FindAndModifyOptions::upsert( bool value )
+{
+    m_upsert = value;
+    return *this;
+}
+
+// ** FindAndModifyOptions::remove
+FindAndModifyOptions& FindAndModifyOptions::remove( bool value )
+{
+    m_remove = value;
+    return *this;
+}
+
+// ** FindAndModifyOptions::returnNew
+FindAndModifyOptions& FindAndModifyOptions::returnNew( bool value )
+{
+    m_returnNew = value;
+    return *this;
+}
+
+// ** FindAndModifyOptions::fields
+FindAndModifyOptions& FindAndModifyOptions::fields( const BSON& projection )
+{
+    m_fields = projection;
+    return *this;
+}
+
+// ** Collection::Collection
+Collection::Collection( ConnectionPool* pool, mongoc_client_t* client, const std::string& db, mongoc_collection_t* collection ) : m_pool( pool ), m_client( client ), m_db( db ), m_collection( collection ), m_writes( std::make_shared<std::atomic<uint64_t> >( 0 ) )
+{
+    m_namespace = m_db + "." + mongoc_collection_get_name( m_collection );
+}
+
 Collection::~Collection( void )
 {
     mongoc_collection_destroy( m_collection );
@@ -44,31 +210,385 @@ Collection::~Collection( void )
 // ** Collection::drop
 void Collection::drop( void )
 {
+    invalidate();
+
     bson_error_t err;
-    if( !mongoc_collection_drop( m_collection, &err ) ) {
+    bool         success = mongoc_collection_drop( m_collection, &err );
+
+    invalidate();
+
+    if( !success ) {
         printf( "Collection::drop : %s\n", err.message );
+        return;
+    }
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->clear();
     }
 }
 
 // ** Collection::find
-CursorPtr Collection::find( const BSON& query ) const
+CursorPtr Collection::find( const BSON& query, const FindOptions& options ) const
 {
-    mongoc_cursor_t* cursor = mongoc_collection_find( m_collection, MONGOC_QUERY_NONE, 0, 0, 0, query.raw(), NULL, NULL );
+    int flags = MONGOC_QUERY_NONE;
+
+    if( options.m_noCursorTimeout ) {
+        flags |= MONGOC_QUERY_NO_CURSOR_TIMEOUT;
+    }
+
+    // Sort, hint and time limit are passed as query modifiers, so the query is wrapped only when they are set.
+    BSON selector = query;
+
+    if( options.m_sort.raw() || options.m_hint.raw() || !options.m_hintName.empty() || options.m_maxTimeMS ) {
+        selector = BSON();
+        selector.setDocument( "$query", query );
+
+        if( options.m_sort.raw() ) {
+            selector.setDocument( "$orderby", options.m_sort );
+        }
+        if( options.m_hint.raw() ) {
+            selector.setDocument( "$hint", options.m_hint );
+        }
+        else if( !options.m_hintName.empty() ) {
+            selector.set( "$hint", options.m_hintName );
+        }
+        if( options.m_maxTimeMS ) {
+            selector.set( "$maxTimeMS", ( int )options.m_maxTimeMS );
+        }
+    }
+
+    mongoc_cursor_t* cursor = mongoc_collection_find( m_collection, ( mongoc_query_flags_t )flags, options.m_skip, options.m_limit, options.m_batchSize, selector.raw(), options.m_projection.raw(), NULL );
     return cursor ? CursorPtr( new Cursor( cursor ) ) : NULL;
 }
 
 // ** Collection::findOne
-DocumentPtr Collection::findOne( const BSON& query ) const
+DocumentPtr Collection::findOne( const BSON& query, const FindOptions& options ) const
+{
+    if( m_existenceFilter && m_existenceFilter->rejects( query ) ) {
+        return NULL;
+    }
+
+    if( !m_documentCache && !m_singleFlight ) {
+        return fetchOne( query, options );
+    }
+
+    std::string key        = requestKey( query, options );
+    uint64_t    generation = 0;
+
+    if( m_documentCache ) {
+        DocumentPtr document = m_documentCache->get( m_namespace, key, &generation );
+
+        if( document ) {
+            return document;
+        }
+    }
+
+    DocumentPtr document;
+
+    if( m_singleFlight ) {
+        // Reads from different write epochs never share a request, so a fetch started before a write can't serve readers that arrive after it.
+        uint64_t    writes = *m_writes;
+        std::string flight = m_namespace + '\0' + key;
+        flight.append( reinterpret_cast<const char*>( &generation ), sizeof( generation ) );
+        flight.append( reinterpret_cast<const char*>( &writes ), sizeof( writes ) );
+
+        document = m_singleFlight->run( flight, [this, &query, &options]() { return fetchOne( query, options ); } );
+    } else {
+        document = fetchOne( query, options );
+    }
+
+    if( document && m_documentCache ) {
+        m_documentCache->put( m_namespace, key, document, generation );
+    }
+
+    return document;
+}
+
+// ** Collection::fetchOne
+DocumentPtr Collection::fetchOne( const BSON& query, const FindOptions& options ) const
 {
-    CursorPtr cursor = find( query );
+    FindOptions single = options;
+    single.limit( 1 );
+    CursorPtr cursor = find( query, single );
     return cursor != NULL ? cursor->next() : NULL;
 }
 
+// ** Collection::requestKey
+std::string Collection::requestKey( const BSON& query, const FindOptions& options )
+{
+    // Options that change a result are a part of a key, BSON documents are length-prefixed, so the key is unambiguous.
+    std::string key;
+    appendKey( key, query );
+    appendKey( key, options.m_projection );
+    appendKey( key, options.m_sort );
+    key.append( reinterpret_cast<const char*>( &options.m_skip ), sizeof( options.m_skip ) );
+
+    return key;
+}
+
+// ** Collection::appendKey
+void Collection::appendKey( std::string& key, const BSON& value )
+{
+    static const uint32_t Empty = 0;
+
+    if( value.raw() ) {
+        key.append( reinterpret_cast<const char*>( bson_get_data( value.raw() ) ), value.raw()->len );
+    } else {
+        key.append( reinterpret_cast<const char*>( &Empty ), sizeof( Empty ) );
+    }
+}
+
+//! Fetches a chunk of unique identifiers with an $in query and stores found documents by identifier positions.
+static void fetchChunk( const Collection& collection, const std::vector<OID>& ids, size_t first, size_t count, const std::unordered_map<OID, size_t>& positions, std::vector<DocumentPtr>& found )
+{
+    ArraySelector values;
+
+    for( size_t i = first; i < first + count; i++ ) {
+        values << ids[i];
+    }
+
+    CursorPtr cursor = collection.find( DOCUMENT( "_id" << DOCUMENT( "$in" << values ) ), FindOptions().batchSize( ( uint32_t )count ) );
+
+    if( !cursor ) {
+        return;
+    }
+
+    for( DocumentPtr document = cursor->next(); document; document = cursor->next() ) {
+        std::unordered_map<OID, size_t>::const_iterator i = positions.find( document->_id() );
+
+        if( i != positions.end() ) {
+            found[i->second] = document;
+        }
+    }
+}
+
+// ** Collection::findMany
+std::vector<DocumentPtr> Collection::findMany( const std::vector<OID>& ids, uint32_t chunkSize, uint32_t parallelism ) const
+{
+    std::unordered_map<OID, size_t> positions;
+    std::vector<OID>                unique;
+
+    positions.reserve( ids.size() );
+    unique.reserve( ids.size() );
+
+    // Identifiers an existence filter reports as missing are not queried.
+    bool filtered = m_existenceFilter && m_existenceFilter->field() == "_id";
+
+    for( size_t i = 0; i < ids.size(); i++ ) {
+        if( filtered && !m_existenceFilter->mayContain( ids[i] ) ) {
+            continue;
+        }
+
+        if( positions.insert( std::make_pair( ids[i], unique.size() ) ).second ) {
+            unique.push_back( ids[i] );
+        }
+    }
+
+    std::vector<DocumentPtr> found( unique.size() );
+    size_t                   chunk  = std::max( chunkSize, 1u );
+    size_t                   chunks = ( unique.size() + chunk - 1 ) / chunk;
+    std::atomic<size_t>      next( 0 );
+    std::string              name   = mongoc_collection_get_name( m_collection );
+
+    // Each thread claims chunks until all of them are fetched.
+    std::function<void( const Collection& )> fetch = [&]( const Collection& collection ) {
+        for( size_t i = next++; i < chunks; i = next++ ) {
+            fetchChunk( collection, unique, i * chunk, std::min( chunk, unique.size() - i * chunk ), positions, found );
+        }
+    };
+
+    // A client is not thread-safe, so each helper thread checks out its own one and only free clients are used.
+    std::vector<std::thread> helpers;
+
+    for( size_t i = 1; m_pool && i < std::min( ( size_t )parallelism, chunks ); i++ ) {
+        ConnectionPtr connection = m_pool->tryAcquire();
+
+        if( !connection ) {
+            break;
+        }
+
+        helpers.push_back( std::thread( [connection, name, &fetch]() { fetch( *connection->collection( name ) ); } ) );
+    }
+
+    fetch( *this );
+
+    for( size_t i = 0; i < helpers.size(); i++ ) {
+        helpers[i].join();
+    }
+
+    std::vector<DocumentPtr> result( ids.size() );
+
+    for( size_t i = 0; i < ids.size(); i++ ) {
+        std::unordered_map<OID, size_t>::const_iterator position = positions.find( ids[i] );
+
+        if( position != positions.end() ) {
+            result[i] = found[position->second];
+        }
+    }
+
+    return result;
+}
+
+// ** Collection::findAndModify
+DocumentPtr Collection::findAndModify( const BSON& query, const FindAndModifyOptions& options )
+{
+    invalidate();
+
+    bool     keyed = false;
+    uint64_t epoch = 0;
+
+    if( m_existenceFilter ) {
+        epoch = m_existenceFilter->seedEpoch();
+        m_existenceFilter->beginWrite();
+    }
+
+    if( m_existenceFilter && options.m_update.raw() ) {
+        keyed = m_existenceFilter->updated( query, options.m_update, options.m_upsert );
+    }
+
+    bson_t       reply;
+    bson_error_t err;
+    bool         success = mongoc_collection_find_and_modify( m_collection, query.raw(), options.m_sort.raw(), options.m_update.raw(), options.m_fields.raw()
+                                                            , options.m_remove, options.m_upsert, options.m_returnNew, &reply, &err );
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->endWrite();
+    }
+
+    invalidate();
+
+    if( !success ) {
+        printf( "Collection::findAndModify : %s\n", err.message );
+        bson_destroy( &reply );
+        return NULL;
+    }
+
+    bson_iter_t value;
+    DocumentPtr document;
+
+    if( bson_iter_init_find( &value, &reply, "value" ) && BSON_ITER_HOLDS_DOCUMENT( &value ) ) {
+        document = Iter( &value ).toObject().toOwned();
+    }
+
+    if( m_existenceFilter ) {
+        Iter        key;
+        bson_iter_t upserted;
+        bson_iter_t root;
+
+        // A removal is exact when a query selects a key, and a server-side identifier of an upserted document is reported separately.
+        if( options.m_remove && document && m_existenceFilter->findKey( query, key ) ) {
+            m_existenceFilter->remove( key, 1, epoch );
+        }
+        else if( options.m_upsert && m_existenceFilter->field() == "_id" ) {
+            if( bson_iter_init( &root, &reply ) && bson_iter_find_descendant( &root, "lastErrorObject.upserted", &upserted ) ) {
+                m_existenceFilter->add( Iter( &upserted ) );
+            }
+            // Without an updatedExisting flag a generated identifier may have been missed.
+            else if( !keyed && !( bson_iter_init( &root, &reply ) && bson_iter_find_descendant( &root, "lastErrorObject.updatedExisting", &upserted ) && bson_iter_as_bool( &upserted ) ) ) {
+                m_existenceFilter->markStale();
+            }
+        }
+    }
+
+    bson_destroy( &reply );
+    return document;
+}
+
+// ** Collection::incrementAndGet
+int64_t Collection::incrementAndGet( const BSON& query, const char* field, int64_t delta, bool* success )
+{
+    DocumentSelector increment;
+    increment << field << delta;
+
+    DocumentPtr document = findAndModify( query, FindAndModifyOptions().update( DOCUMENT( "$inc" << increment ) ).upsert().returnNew().fields( DOCUMENT( field << 1 ) ) );
+
+    bson_iter_t value;
+    int64_t     result = 0;
+    bool        found  = document && bson_iter_init_find( &value, document->value(), field );
+
+    // $inc keeps a double as a double, and a field created by $inc from an int32 delta stays int32.
+    if( found ) {
+        switch( bson_iter_type( &value ) ) {
+        case BSON_TYPE_INT64:   result = bson_iter_int64( &value );
+                                break;
+        case BSON_TYPE_INT32:   result = bson_iter_int32( &value );
+                                break;
+        case BSON_TYPE_DOUBLE:  found = bson_iter_double( &value ) >= -9223372036854775808.0 && bson_iter_double( &value ) < 9223372036854775808.0;
+                                result = found ? ( int64_t )bson_iter_double( &value ) : 0;
+                                break;
+        default:                found = false;
+                                break;
+        }
+    }
+
+    if( success ) {
+        *success = found;
+    }
+
+    return result;
+}
+
+// ** Collection::incrementAndGet
+int64_t Collection::incrementAndGet( const std::string& key, const char* field, int64_t delta, bool* success )
+{
+    return incrementAndGet( DOCUMENT( "_id" << key ), field, delta, success );
+}
+
+// ** Collection::popOne
+DocumentPtr Collection::popOne( const BSON& query, const BSON& sort )
+{
+    return findAndModify( query, FindAndModifyOptions().sort( sort ).remove() );
+}
+
+// ** Collection::aggregate
+CursorPtr Collection::aggregate( const Pipeline& pipeline, const AggregateOptions& options ) const
+{
+    BSON command;
+    command.setArray( "pipeline", pipeline.stages() );
+
+    BSON opts;
+
+    if( options.m_allowDiskUse ) {
+        opts.set( "allowDiskUse", true );
+    }
+
+    if( options.m_batchSize ) {
+        opts.set( "batchSize", ( int )options.m_batchSize );
+    }
+
+    if( options.m_maxTimeMS ) {
+        opts.set( "maxTimeMS", ( int )options.m_maxTimeMS );
+    }
+
+    mongoc_cursor_t* cursor = mongoc_collection_aggregate( m_collection, MONGOC_QUERY_NONE, command.raw(), opts.raw(), NULL );
+
+    if( cursor && options.m_batchSize ) {
+        mongoc_cursor_set_batch_size( cursor, options.m_batchSize );
+    }
+
+    return cursor ? CursorPtr( new Cursor( cursor ) ) : NULL;
+}
+
 // ** Collection::update
-bool Collection::update( const BSON& query, const BSON& value )
+bool Collection::update( const BSON& query, const BSON& value, const WriteConcern& writeConcern )
 {
+    invalidate();
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->beginWrite();
+        m_existenceFilter->updated( query, value, false );
+    }
+
     bson_error_t err;
-    if( !mongoc_collection_update( m_collection, MONGOC_UPDATE_NONE, query.raw(), value.raw(), NULL, &err ) ) {
+    bool         success = mongoc_collection_update( m_collection, MONGOC_UPDATE_NONE, query.raw(), value.raw(), writeConcern.raw(), &err );
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->endWrite();
+    }
+
+    invalidate();
+
+    if( !success ) {
         printf( "Error: %s\n", err.message );
         return false;
     }
@@ -77,22 +597,103 @@ bool Collection::update( const BSON& query, const BSON& value )
 }
 
 // ** Collection::upsert
-bool Collection::upsert( const BSON& query, const BSON& value )
+bool Collection::upsert( const BSON& query, const BSON& value, const WriteConcern& writeConcern )
 {
+    invalidate();
+
+    bool keyed = false;
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->beginWrite();
+        keyed = m_existenceFilter->updated( query, value, true );
+    }
+
     bson_error_t err;
-    if( !mongoc_collection_update( m_collection, MONGOC_UPDATE_UPSERT, query.raw(), value.raw(), NULL, &err ) ) {
+    bool         success = mongoc_collection_update( m_collection, MONGOC_UPDATE_UPSERT, query.raw(), value.raw(), writeConcern.raw(), &err );
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->endWrite();
+    }
+
+    invalidate();
+
+    if( !success ) {
         printf( "Error: %s\n", err.message );
         return false;
     }
 
+    // Identifiers generated by a server for upserted documents are reported in a reply, unacknowledged writes have none.
+    if( m_existenceFilter ) {
+        const mongoc_write_concern_t* concern      = writeConcern.raw() ? writeConcern.raw() : mongoc_collection_get_write_concern( m_collection );
+        bool                          acknowledged = !concern || mongoc_write_concern_is_acknowledged( concern );
+
+        m_existenceFilter->upserted( acknowledged ? mongoc_collection_get_last_error( m_collection ) : NULL, keyed );
+    }
+
     return true;
 }
 
+// ** Collection::update
+bool Collection::update( const BSON& query, const Update& update, const WriteConcern& writeConcern )
+{
+    if( !update.isValid() ) {
+        printf( "Error: %s\n", update.error().c_str() );
+        return false;
+    }
+
+    if( update.isEmpty() ) {
+        printf( "Error: update has no operators\n" );
+        return false;
+    }
+
+    return this->update( query, update.bson(), writeConcern );
+}
+
+// ** Collection::upsert
+bool Collection::upsert( const BSON& query, const Update& update, const WriteConcern& writeConcern )
+{
+    if( !update.isValid() ) {
+        printf( "Error: %s\n", update.error().c_str() );
+        return false;
+    }
+
+    if( update.isEmpty() ) {
+        printf( "Error: update has no operators\n" );
+        return false;
+    }
+
+    return upsert( query, update.bson(), writeConcern );
+}
+
 // ** Collection::insert
-bool Collection::insert( const BSON& value )
+bool Collection::insert( const BSON& value, const WriteConcern& writeConcern )
 {
+    invalidate();
+
+    BSON document = value;
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->beginWrite();
+    }
+
+    // The identifier is generated here instead of by a driver, so a filter knows the inserted key.
+    if( m_existenceFilter && !m_existenceFilter->inserted( value ) && m_existenceFilter->field() == "_id" ) {
+        document = BSON();
+        document.set( "_id", OID::generate() );
+        bson_concat( document.raw(), value.raw() );
+        m_existenceFilter->inserted( document );
+    }
+
     bson_error_t err;
-    if( !mongoc_collection_insert( m_collection, MONGOC_INSERT_NONE, value.raw(), NULL, &err ) ) {
+    bool         success = mongoc_collection_insert( m_collection, MONGOC_INSERT_NONE, document.raw(), writeConcern.raw(), &err );
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->endWrite();
+    }
+
+    invalidate();
+
+    if( !success ) {
         printf( "Error: %s\n", err.message );
         return false;
     }
@@ -101,42 +702,363 @@ bool Collection::insert( const BSON& value )
 }
 
 // ** Collection::remove
-bool Collection::remove( const BSON& query )
+bool Collection::remove( const BSON& query, const WriteConcern& writeConcern )
 {
+    invalidate();
+
+    // A seed that starts before the removal is applied may miss the removed key, so its decrement would be wrong.
+    uint64_t epoch = m_existenceFilter ? m_existenceFilter->seedEpoch() : 0;
+
     bson_error_t err;
-    if( !mongoc_collection_remove( m_collection, MONGOC_REMOVE_NONE, query.raw(), NULL, &err ) ) {
+    bool         success = mongoc_collection_remove( m_collection, MONGOC_REMOVE_NONE, query.raw(), writeConcern.raw(), &err );
+
+    invalidate();
+
+    if( !success ) {
         printf( "Error: %s\n", err.message );
         return false;
     }
+
+    // Only removals by an exact key can decrement a filter, other removals leave false positives.
+    Iter key;
+
+    if( m_existenceFilter && m_existenceFilter->findKey( query, key ) ) {
+        const bson_t* reply = mongoc_collection_get_last_error( m_collection );
+        bson_iter_t   removed;
+
+        if( reply && bson_iter_init_find( &removed, reply, "nRemoved" ) ) {
+            m_existenceFilter->remove( key, bson_iter_as_int64( &removed ), epoch );
+        }
+    }
     
     return true;
 }
 
 // ** Collection::count
-int Collection::count( const BSON& query ) const
+int64_t Collection::count( const BSON& query ) const
 {
+    std::string key;
+
+    if( m_countCache ) {
+        // Any write made since entries were cached makes them stale.
+        if( m_countCache->writes != *m_writes ) {
+            m_countCache->entries.clear();
+            m_countCache->writes = *m_writes;
+        }
+
+        // A NULL query gets an empty key instead of dereferencing a missing document.
+        appendKey( key, query );
+
+        std::unordered_map<std::string, CountCache::Entry>::const_iterator i = m_countCache->entries.find( key );
+
+        if( i != m_countCache->entries.end() && i->second.expires > std::chrono::steady_clock::now() ) {
+            return i->second.count;
+        }
+    }
+
     bson_error_t err;
     int64_t result = mongoc_collection_count( m_collection, MONGOC_QUERY_NONE, query.raw(), 0, 0, NULL, &err );
 
-    return ( int )result;
+    if( result < 0 ) {
+        printf( "Collection::count : %s\n", err.message );
+        return -1;
+    }
+
+    if( m_countCache ) {
+        if( m_countCache->entries.size() >= m_countCache->maxEntries ) {
+            m_countCache->entries.clear();
+        }
+
+        CountCache::Entry& entry = m_countCache->entries[key];
+        entry.count   = result;
+        entry.expires = std::chrono::steady_clock::now() + m_countCache->ttl;
+    }
+
+    return result;
+}
+
+// ** Collection::estimatedCount
+int64_t Collection::estimatedCount( void ) const
+{
+    // A count command without a query is answered from collection metadata.
+    BSON command;
+    command.set( "count", mongoc_collection_get_name( m_collection ) );
+
+    bson_t       reply;
+    bson_error_t err;
+    int64_t      result = -1;
+
+    if( mongoc_collection_command_simple( m_collection, command.raw(), NULL, &reply, &err ) ) {
+        bson_iter_t n;
+
+        if( bson_iter_init_find( &n, &reply, "n" ) ) {
+            result = bson_iter_as_int64( &n );
+        }
+    } else {
+        printf( "Collection::estimatedCount : %s\n", err.message );
+    }
+
+    bson_destroy( &reply );
+    return result;
+}
+
+// ** Collection::enableCountCache
+void Collection::enableCountCache( uint32_t ttlMs, size_t maxEntries )
+{
+    m_countCache.reset( new CountCache );
+    m_countCache->ttl        = std::chrono::milliseconds( ttlMs );
+    m_countCache->maxEntries = std::max( maxEntries, ( size_t )1 );
+    m_countCache->writes     = *m_writes;
+}
+
+// ** Collection::disableCountCache
+void Collection::disableCountCache( void )
+{
+    m_countCache.reset();
+}
+
+// ** Collection::setDocumentCache
+void Collection::setDocumentCache( const DocumentCachePtr& cache )
+{
+    m_documentCache = cache;
+}
+
+// ** Collection::setSingleFlight
+void Collection::setSingleFlight( const SingleFlightPtr& group )
+{
+    m_singleFlight = group;
+}
+
+// ** Collection::setExistenceFilter
+bool Collection::setExistenceFilter( const ExistenceFilterPtr& filter, bool seed )
+{
+    m_existenceFilter = filter;
+
+    if( !filter || !seed ) {
+        return false;
+    }
+
+    filter->beginSeed();
+
+    DocumentSelector projection;
+    projection << filter->field().c_str() << 1;
+
+    CursorPtr cursor = find( BSON::object(), FindOptions().projection( projection ).batchSize( 10000 ) );
+
+    if( !cursor ) {
+        filter->endSeed( false );
+        return false;
+    }
+
+    for( DocumentView document = cursor->nextView(); !document.isNull(); document = cursor->nextView() ) {
+        for( Iter field = document.iter(); field.isValid(); field.next() ) {
+            if( filter->field() == field.key() ) {
+                filter->add( field );
+                break;
+            }
+        }
+    }
+
+    bson_error_t err;
+    bool         failed = mongoc_cursor_error( cursor->m_cursor, &err );
+
+    if( failed ) {
+        printf( "Collection::setExistenceFilter : %s\n", err.message );
+    }
+
+    filter->endSeed( !failed );
+    return !failed;
+}
+
+// ** Collection::invalidate
+void Collection::invalidate( void )
+{
+    ( *m_writes )++;
+
+    if( m_documentCache ) {
+        m_documentCache->invalidate( m_namespace );
+    }
+}
+
+// ** Collection::mergeWith
+bool Collection::mergeWith( const CollectionPtr& other, bool drop )
+{
+    MergeOptions options;
+    options.drop = drop;
+    return mergeWith( other, options );
 }
 
 // ** Collection::mergeWith
-void Collection::mergeWith( const CollectionPtr& other, bool drop )
-{
-	assert( false );
-//    CursorPtr   cursor = other->find();
-//    DocumentPtr document;
-//
-//    while( (document = cursor->next()) ) {
-//        BSON value = BSON::fromBSON( document->value() );
-//        value.remove( "_id" );
-//        insert( value );
-//    }
-//
-//    if( drop ) {
-//        other->drop();
-//    }
+bool Collection::mergeWith( const CollectionPtr& other, const MergeOptions& options )
+{
+    if( !other || other.get() == this ) {
+        return false;
+    }
+
+    // Collections of different connections may belong to different deployments, so only a client-side copy is safe.
+    bool merged;
+
+    if( options.serverSide && other->m_client == m_client ) {
+        bool unsupported = false;
+        merged = mergeOnServer( other, options, &unsupported );
+
+        // Any other failure may have written a part of documents, and copying them again would duplicate them.
+        if( !merged && unsupported ) {
+            merged = mergeByCopy( other, options );
+        }
+    } else {
+        merged = mergeByCopy( other, options );
+    }
+
+    if( merged && options.drop ) {
+        other->drop();
+    }
+
+    return merged;
+}
+
+// ** Collection::mergeOnServer
+bool Collection::mergeOnServer( const CollectionPtr& other, const MergeOptions& options, bool* unsupported )
+{
+    DocumentSelector into;
+    into << "db" << m_db << "coll" << mongoc_collection_get_name( m_collection );
+
+    DocumentSelector merge;
+    merge << "into" << into << "whenMatched" << "replace" << "whenNotMatched" << "insert";
+
+    // Without identifiers $merge generates new ones, so merged documents never replace existing ones.
+    Pipeline pipeline;
+
+    if( !options.preserveIds ) {
+        pipeline.project( DOCUMENT( "_id" << 0 ) );
+    }
+
+    pipeline.stage( "$merge", merge );
+
+    CursorPtr cursor = other->aggregate( pipeline, AggregateOptions().allowDiskUse() );
+
+    if( !cursor ) {
+        *unsupported = true;
+        return false;
+    }
+
+    // $merge produces no documents, the aggregation runs on the first iteration.
+    while( !cursor->nextView().isNull() ) {
+    }
+
+    bson_error_t err;
+    bool         failed = mongoc_cursor_error( cursor->m_cursor, &err );
+
+    // Even a failed merge may have written some documents, and written keys are not tracked.
+    invalidate();
+
+    if( m_existenceFilter ) {
+        m_existenceFilter->markStale();
+    }
+
+    if( failed ) {
+        // Servers before 4.2 either don't recognize the $merge stage or are rejected by a driver for an old wire version.
+        *unsupported = ( err.domain == MONGOC_ERROR_PROTOCOL && err.code == MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION )
+                    || err.code == 40324 || err.code == 16436;
+
+        printf( "Collection::mergeWith : %s%s\n", err.message, *unsupported ? ", falling back to a client-side copy" : "" );
+        return false;
+    }
+
+    return true;
+}
+
+// ** Collection::mergeByCopy
+bool Collection::mergeByCopy( const CollectionPtr& other, const MergeOptions& options )
+{
+    uint32_t batchSize = options.batchSize ? options.batchSize : 1000;
+    CursorPtr cursor   = other->find( BSON::object(), FindOptions().batchSize( batchSize ) );
+
+    if( !cursor ) {
+        return false;
+    }
+
+    // A client is not thread-safe, so the source is read ahead only when it has its own client.
+    std::unique_ptr<PrefetchCursor> prefetch;
+
+    if( other->m_client != m_client ) {
+        PrefetchCursor::Options prefetchOptions;
+        prefetchOptions.initialBatchSize = batchSize;
+        prefetchOptions.maxBufferedBytes = options.maxBufferedBytes;
+        prefetch.reset( new PrefetchCursor( cursor, prefetchOptions ) );
+    }
+
+    uint64_t copied  = 0;
+    bool     success = true;
+
+    while( success ) {
+        BulkOperationPtr bulk  = createBulkOperation( false, options.writeConcern );
+        uint32_t         count = 0;
+
+        for( ; count < batchSize; count++ ) {
+            DocumentPtr  document;
+            DocumentView view;
+
+            if( prefetch ) {
+                document = prefetch->next();
+                view     = document ? document->view() : DocumentView();
+            } else {
+                view = cursor->nextView();
+            }
+
+            if( view.isNull() ) {
+                break;
+            }
+
+            bson_t source;
+            bson_init_static( &source, view.data(), view.length() );
+
+            bson_iter_t id;
+            BSON        copy;
+
+            if( options.preserveIds && bson_iter_init_find( &id, &source, "_id" ) ) {
+                // Replace by identifier, so a repeated merge doesn't fail on duplicate keys.
+                BSON query;
+                bson_append_iter( query.raw(), "_id", 3, &id );
+                bson_copy_to_excluding_noinit( &source, copy.raw(), "_id", NULL );
+                bulk->replaceOne( query, copy, true );
+            } else {
+                bson_copy_to_excluding_noinit( &source, copy.raw(), "_id", NULL );
+                bulk->insert( copy );
+            }
+        }
+
+        if( count == 0 ) {
+            break;
+        }
+
+        BulkResult result;
+        success = bulk->execute( &result );
+
+        if( !success ) {
+            printf( "Collection::mergeWith : %s\n", result.writeErrors.empty() ? result.error.c_str() : result.writeErrors[0].message.c_str() );
+            break;
+        }
+
+        copied += count;
+
+        if( options.progress ) {
+            options.progress( copied );
+        }
+    }
+
+    if( prefetch ) {
+        success = success && !prefetch->hasError();
+    } else {
+        bson_error_t err;
+
+        if( mongoc_cursor_error( cursor->m_cursor, &err ) ) {
+            printf( "Collection::mergeWith : %s\n", err.message );
+            success = false;
+        }
+    }
+
+    return success;
 }
 
 // ** Collection::ensureIndex
@@ -169,9 +1091,34 @@ bool Collection::dropIndex( const std::string& name )
 }
 
 // ** Collection::createBulkOperation
-BulkOperationPtr Collection::createBulkOperation( void )
+BulkOperationPtr Collection::createBulkOperation( bool ordered, const WriteConcern& writeConcern )
+{
+    // A bulk operation may outlive a collection, so it captures shared state instead of a collection pointer.
+    WriteCounterPtr    writes = m_writes;
+    DocumentCachePtr   cache  = m_documentCache;
+    ExistenceFilterPtr filter = m_existenceFilter;
+    std::string        ns     = m_namespace;
+
+    // Keys written by a bulk operation are not tracked, so an existence filter becomes stale.
+    std::function<void()> invalidate = [writes, cache, filter, ns]() {
+        ( *writes )++;
+
+        if( cache ) {
+            cache->invalidate( ns );
+        }
+
+        if( filter ) {
+            filter->markStale();
+        }
+    };
+
+    return BulkOperationPtr( new BulkOperation( mongoc_collection_create_bulk_operation( m_collection, ordered, writeConcern.raw() ), invalidate ) );
+}
+
+// ** Collection::setWriteConcern
+void Collection::setWriteConcern( const WriteConcern& writeConcern )
 {
-    return BulkOperationPtr( new BulkOperation( mongoc_collection_create_bulk_operation( m_collection, false, NULL ) ) );
+    mongoc_collection_set_write_concern( m_collection, writeConcern.raw() );
 }
 
 } // namespace mongo
\ No newline at end of file
@@ -30,9 +30,151 @@
 #define __Mongo_Collection_H__
 
 #include "MongoBson.h"
+#include "Pipeline.h"
+#include "Update.h"
+#include "DocumentCache.h"
+#include "SingleFlight.h"
+#include "ExistenceFilter.h"
+
+#include <functional>
 
 namespace mongo {
 
+	//! Options of a find query.
+	/*!
+	Options are set with chained calls, for example:
+
+		collection->find( query, FindOptions().projection( DOCUMENT( "name" << true ) ).sort( DOCUMENT( "age" << -1 ) ).limit( 10 ) );
+	*/
+	class FindOptions {
+	friend class Collection;
+	public:
+
+								//! Constructs FindOptions instance without any options set.
+								FindOptions( void );
+
+		//! Sets fields to return, for example DOCUMENT( "name" << true ).
+		FindOptions&			projection( const BSON& fields );
+
+		//! Sets the maximum number of documents to return.
+		FindOptions&			limit( uint32_t value );
+
+		//! Sets the number of documents to skip.
+		FindOptions&			skip( uint32_t value );
+
+		//! Sets the sort order, for example DOCUMENT( "age" << -1 ).
+		FindOptions&			sort( const BSON& order );
+
+		//! Sets the number of documents returned in a single server batch.
+		FindOptions&			batchSize( uint32_t value );
+
+		//! Forces an index by its key pattern.
+		FindOptions&			hint( const BSON& index );
+
+		//! Forces an index by its name.
+		FindOptions&			hint( const std::string& index );
+
+		//! Sets the time limit for query processing on a server.
+		FindOptions&			maxTimeMS( uint32_t value );
+
+		//! Prevents a server from closing an idle cursor.
+		FindOptions&			noCursorTimeout( bool value = true );
+
+	private:
+
+		BSON					m_projection;		//!< Fields to return.
+		BSON					m_sort;				//!< Sort order.
+		BSON					m_hint;				//!< Index key pattern to use.
+		std::string				m_hintName;			//!< Index name to use.
+		uint32_t				m_limit;			//!< Maximum number of documents.
+		uint32_t				m_skip;				//!< Number of documents to skip.
+		uint32_t				m_batchSize;		//!< Server batch size.
+		uint32_t				m_maxTimeMS;		//!< Server time limit.
+		bool					m_noCursorTimeout;	//!< Flag that disables idle cursor timeout.
+	};
+
+	//! Options of an aggregation.
+	class AggregateOptions {
+	friend class Collection;
+	public:
+
+								//! Constructs default aggregation options.
+								AggregateOptions( void );
+
+		//! Allows stages to write temporary data to disk when they exceed a memory limit.
+		AggregateOptions&		allowDiskUse( bool value = true );
+
+		//! Sets the number of documents returned in a single server batch.
+		AggregateOptions&		batchSize( uint32_t value );
+
+		//! Sets the time limit for aggregation processing on a server.
+		AggregateOptions&		maxTimeMS( uint32_t value );
+
+	private:
+
+		uint32_t				m_batchSize;		//!< Server batch size.
+		uint32_t				m_maxTimeMS;		//!< Server time limit.
+		bool					m_allowDiskUse;		//!< Flag that allows external sorting.
+	};
+
+	//! Options of a findAndModify operation.
+	/*!
+	Either an update or a removal should be set, for example:
+
+		collection->findAndModify( query, FindAndModifyOptions().update( DOCUMENT( "$set" << DOCUMENT( "state" << "running" ) ) ).returnNew() );
+	*/
+	class FindAndModifyOptions {
+	friend class Collection;
+	public:
+
+								//! Constructs default findAndModify options.
+								FindAndModifyOptions( void );
+
+		//! Sets the sort order that selects a document when several documents match.
+		FindAndModifyOptions&	sort( const BSON& order );
+
+		//! Sets an update document or a replacement.
+		FindAndModifyOptions&	update( const BSON& value );
+
+		//! Inserts a document when nothing matches a query.
+		FindAndModifyOptions&	upsert( bool value = true );
+
+		//! Removes a matched document instead of updating it.
+		FindAndModifyOptions&	remove( bool value = true );
+
+		//! Returns a modified document instead of an original one.
+		FindAndModifyOptions&	returnNew( bool value = true );
+
+		//! Sets fields to return.
+		FindAndModifyOptions&	fields( const BSON& projection );
+
+	private:
+
+		BSON					m_sort;			//!< Sort order.
+		BSON					m_update;		//!< Update document.
+		BSON					m_fields;		//!< Fields to return.
+		bool					m_upsert;		//!< Flag that enables an upsert.
+		bool					m_remove;		//!< Flag that enables a removal.
+		bool					m_returnNew;	//!< Flag that returns a modified document.
+	};
+
+	//! Options of a collection merge.
+	struct MergeOptions {
+		//! Progress callback, receives the number of copied documents.
+		typedef std::function<void( uint64_t )> Progress;
+
+								MergeOptions( void )
+									: preserveIds( false ), drop( false ), serverSide( true ), batchSize( 1000 ), maxBufferedBytes( 16 * 1024 * 1024 ) {}
+
+		bool					preserveIds;		//!< Keeps source identifiers and replaces documents with matching identifiers, otherwise new identifiers are generated.
+		bool					drop;				//!< Drops the source collection after a successful merge.
+		bool					serverSide;			//!< Tries a server-side $merge first when both collections belong to the same connection, a client-side copy is used only if $merge is unsupported.
+		uint32_t				batchSize;			//!< Number of documents in a single bulk insert of a client-side copy.
+		size_t					maxBufferedBytes;	//!< Memory cap for documents read ahead of bulk inserts.
+		WriteConcern			writeConcern;		//!< Write concern of bulk inserts.
+		Progress				progress;			//!< Called after each copied batch of a client-side copy.
+	};
+
 	//! MongoDB collection accessor.
     class Collection {
     friend class Connection;
@@ -46,34 +188,150 @@ namespace mongo {
 		//! Find a documents that match the query parameter.
 		/*!
 		\param query Document query.
+		\param options Projection, sort, limit and other query options.
 		\return The resulting cursor instance.
 		*/
-        CursorPtr               find( const BSON& query = BSON::object() ) const;
+        CursorPtr               find( const BSON& query = BSON::object(), const FindOptions& options = FindOptions() ) const;
 
 		//! Find a single document that matches a query.
 		/*!
+		Found documents are served from and stored to a document cache when it is attached, and
+		identical concurrent reads share a single request when a single-flight group is attached.
+		Lookups of keys that an existence filter reports as missing return NULL without a request.
 		\param query Document query.
+		\param options Query options, the limit is always set to one.
 		\return Document instance that matches a query, otherwise NULL.
 		*/
-        DocumentPtr             findOne( const BSON& query ) const;
+        DocumentPtr             findOne( const BSON& query, const FindOptions& options = FindOptions() ) const;
+
+		//! Finds documents by identifiers.
+		/*!
+		Identifiers are deduplicated and fetched with $in queries of up to chunkSize identifiers.
+		When the collection belongs to a pooled connection, chunks are fetched in parallel over
+		clients checked out from the pool without waiting for busy ones, otherwise one by one.
+		\param ids Document identifiers.
+		\param chunkSize Maximum number of identifiers in a single query.
+		\param parallelism Maximum number of concurrent queries including the calling thread.
+		\return Documents in the order of identifiers, NULL for missing ones.
+		*/
+		std::vector<DocumentPtr>	findMany( const std::vector<OID>& ids, uint32_t chunkSize = 500, uint32_t parallelism = 4 ) const;
+
+		//! Atomically modifies a single document and returns it.
+		/*!
+		\param query Document query.
+		\param options Update or removal options.
+		\return An original or a modified document, NULL if nothing matched or an operation failed.
+		*/
+		DocumentPtr				findAndModify( const BSON& query, const FindAndModifyOptions& options );
+
+		//! Atomically increments a numeric field of a matching document and returns a new value.
+		/*!
+		A document is created when nothing matches a query, so this also serves as a counter initialization.
+		\param query Document query.
+		\param field Numeric field name.
+		\param delta Increment value.
+		\param success Optional flag that receives false if an operation failed.
+		\return The incremented field value truncated to an integer, 0 if an operation failed.
+		*/
+		int64_t					incrementAndGet( const BSON& query, const char* field, int64_t delta = 1, bool* success = NULL );
+
+		//! Atomically increments a numeric field of a document with a specified string identifier.
+		int64_t					incrementAndGet( const std::string& key, const char* field, int64_t delta = 1, bool* success = NULL );
+
+		//! Atomically removes and returns the first document that matches a query, for example a job queue entry.
+		DocumentPtr				popOne( const BSON& query = BSON::object(), const BSON& sort = BSON::object() );
+
+		//! Runs an aggregation pipeline.
+		/*!
+		Results are streamed from a server in batches, so large results are not buffered in memory.
+		\param pipeline Aggregation pipeline.
+		\param options Aggregation options.
+		\return The resulting cursor instance.
+		*/
+		CursorPtr				aggregate( const Pipeline& pipeline, const AggregateOptions& options = AggregateOptions() ) const;
 
 		//! Updates a documents that match an update criteria.
-        bool                    update( const BSON& query, const BSON& value );
+        bool                    update( const BSON& query, const BSON& value, const WriteConcern& writeConcern = WriteConcern() );
 
 		//! Updates or creates a new record.
-        bool                    upsert( const BSON& query, const BSON& value );
+        bool                    upsert( const BSON& query, const BSON& value, const WriteConcern& writeConcern = WriteConcern() );
+
+		//! Applies update operators to documents that match an update criteria, an invalid or empty update is not sent.
+        bool                    update( const BSON& query, const Update& update, const WriteConcern& writeConcern = WriteConcern() );
+
+		//! Applies update operators to a matching document or creates a new one, an invalid or empty update is not sent.
+        bool                    upsert( const BSON& query, const Update& update, const WriteConcern& writeConcern = WriteConcern() );
 
 		//! Inserts a new document to a collection.
-        bool                    insert( const BSON& value );
+        bool                    insert( const BSON& value, const WriteConcern& writeConcern = WriteConcern() );
 
 		//! Removes documents that match a query criteria.
-        bool                    remove( const BSON& query );
+        bool                    remove( const BSON& query, const WriteConcern& writeConcern = WriteConcern() );
 
-		//! Returns the total number of documents that match a specified criteria.
-        int                     count( const BSON& query = BSON::object() ) const;
+		//! Returns the number of documents that match a specified criteria, -1 on error.
+		/*!
+		Counts are exact, so a non-indexed query scans a collection. Results are served from
+		a count cache when it is enabled.
+		*/
+        int64_t                 count( const BSON& query = BSON::object() ) const;
+
+		//! Returns the number of documents from collection metadata without scanning, -1 on error.
+		/*!
+		An estimate may be inaccurate after an unclean shutdown or during chunk migrations of a sharded cluster.
+		*/
+		int64_t					estimatedCount( void ) const;
+
+		//! Enables caching of count results.
+		/*!
+		Cached counts expire after a TTL and are dropped by any write made through this collection,
+		including bulk operations created by it. Writes made by other clients are not tracked.
+		\param ttlMs Lifetime of a cached count in milliseconds.
+		\param maxEntries Maximum number of cached queries, the cache is cleared when it is full.
+		*/
+		void					enableCountCache( uint32_t ttlMs, size_t maxEntries = 1024 );
 
-		//! Merges two collections.
-        void                    mergeWith( const CollectionPtr& other, bool drop = false );
+		//! Disables caching of count results.
+		void					disableCountCache( void );
+
+		//! Attaches a document cache used by findOne, NULL detaches a cache.
+		/*!
+		A cache may be shared with other collections, writes made through this collection and
+		its bulk operations invalidate cached documents of this collection.
+		*/
+		void					setDocumentCache( const DocumentCachePtr& cache );
+
+		//! Attaches a single-flight group used by findOne, NULL detaches a group.
+		/*!
+		A group is shared by collections of different threads, concurrent findOne calls with
+		identical queries and options in any of them share a single request.
+		*/
+		void					setSingleFlight( const SingleFlightPtr& group );
+
+		//! Attaches an existence filter used by findOne to skip lookups of missing keys, NULL detaches a filter.
+		/*!
+		A filter is kept current by writes made through this collection and may be shared with
+		collections of other threads. Documents inserted without an identifier receive a generated
+		one when a filter tracks _id, so the filter sees every inserted key.
+		\param filter Existence filter.
+		\param seed Seeds a filter with a projected scan of key values.
+		\return true if a filter was seeded.
+		*/
+		bool					setExistenceFilter( const ExistenceFilterPtr& filter, bool seed = true );
+
+		//! Merges documents of another collection into this one.
+		/*!
+		A merge runs on a server with a $merge aggregation stage when both collections belong
+		to the same connection. Otherwise, or if a server doesn't support $merge, documents are
+		copied with unordered bulk inserts. When the source collection has its own connection,
+		the source is read ahead on a background thread while bulk inserts are executed.
+		\param other Source collection.
+		\param options Merge options.
+		\return true if all documents were merged.
+		*/
+		bool					mergeWith( const CollectionPtr& other, const MergeOptions& options );
+
+		//! Copies documents of another collection with new identifiers.
+        bool                    mergeWith( const CollectionPtr& other, bool drop = false );
 
 		//! Creates a new collection index.
         bool                    ensureIndex( const std::string& name, const BSON& keys, bool unique = false );
@@ -82,17 +340,80 @@ namespace mongo {
         bool                    dropIndex( const std::string& name );
 
 		//! Creates a bulk operation instance to work with this collection.
-        BulkOperationPtr        createBulkOperation( void );
+		/*!
+		\param ordered Ordered operations are executed one by one and stop at the first error,
+		unordered operations may be executed in any order and continue after errors.
+		\param writeConcern Write concern of a bulk operation, a collection default is used if not set.
+		*/
+        BulkOperationPtr        createBulkOperation( bool ordered = false, const WriteConcern& writeConcern = WriteConcern() );
+
+		//! Sets a default write concern for this collection, an unset write concern restores a connection default.
+		void					setWriteConcern( const WriteConcern& writeConcern );
 
     private:
 
 								//! Constructs a Collection instance.
-                                Collection( mongoc_collection_t* collection );
+                                Collection( ConnectionPool* pool, mongoc_client_t* client, const std::string& db, mongoc_collection_t* collection );
+
+		//! Cached count results.
+		struct CountCache;
+
+		//! Invalidates cached results, called both before and after a write.
+		/*!
+		The second call bumps a cache generation once the write is applied, so a concurrent findOne
+		that fetched a pre-write document in between can't put it to a cache.
+		*/
+		void					invalidate( void );
+
+		//! Returns a key of a findOne request that identifies it in caches and single-flight groups.
+		static std::string		requestKey( const BSON& query, const FindOptions& options );
+
+		//! Appends document bytes to a request key.
+		static void				appendKey( std::string& key, const BSON& value );
+
+		//! Fetches a single document from a server.
+		DocumentPtr				fetchOne( const BSON& query, const FindOptions& options ) const;
+
+		//! Merges another collection with a server-side aggregation.
+		/*!
+		\param unsupported Set to true if a server rejected $merge before writing anything, so a client-side copy is safe.
+		*/
+		bool					mergeOnServer( const CollectionPtr& other, const MergeOptions& options, bool* unsupported );
+
+		//! Merges another collection by copying documents with bulk inserts.
+		bool					mergeByCopy( const CollectionPtr& other, const MergeOptions& options );
 
     private:
 
+		//! Pool of a parent connection, NULL if a connection is not pooled.
+		ConnectionPool*			m_pool;
+
+		//! Parent client.
+		mongoc_client_t*		m_client;
+
+		//! Database name.
+		std::string				m_db;
+
+		//! Collection namespace, a database name and a collection name separated by a dot.
+		std::string				m_namespace;
+
 		//! Actual collection pointer.
         mongoc_collection_t*    m_collection;
+
+		//! Number of writes made through this collection and its bulk operations.
+		WriteCounterPtr			m_writes;
+
+		//! Cached count results, NULL if caching is disabled.
+		mutable std::unique_ptr<CountCache>	m_countCache;
+
+		//! Attached document cache.
+		DocumentCachePtr		m_documentCache;
+
+		//! Attached single-flight group.
+		SingleFlightPtr			m_singleFlight;
+
+		//! Attached existence filter.
+		ExistenceFilterPtr		m_existenceFilter;
     };
 
 } // namespace mongo
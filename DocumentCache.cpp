@@ -0,0 +1,187 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "DocumentCache.h"
+
+#include <algorithm>
+
+namespace mongo {
+
+// ** DocumentCache::DocumentCache
+DocumentCache::DocumentCache( const Options& options )
+	: m_options( options ), m_hits( 0 ), m_misses( 0 ), m_evictions( 0 ), m_invalidations( 0 )
+{
+	m_options.shards = std::max( m_options.shards, 1u );
+	m_shards.reset( new Shard[m_options.shards] );
+}
+
+// ** DocumentCache::shard
+DocumentCache::Shard& DocumentCache::shard( const std::string& key )
+{
+	return m_shards[std::hash<std::string>()( key ) % m_options.shards];
+}
+
+// ** DocumentCache::generation
+uint64_t DocumentCache::generation( const Shard& shard, const std::string& ns )
+{
+	Generations::const_iterator i = shard.generations.find( ns );
+	return i != shard.generations.end() ? i->second : 0;
+}
+
+// ** DocumentCache::erase
+void DocumentCache::erase( Shard& shard, Entries::iterator entry )
+{
+	shard.bytes -= entry->bytes;
+	shard.index.erase( entry->key );
+	shard.lru.erase( entry );
+}
+
+// ** DocumentCache::get
+DocumentPtr DocumentCache::get( const std::string& ns, const std::string& key, uint64_t* generation )
+{
+	std::string id = ns;
+	id += '\0';
+	id += key;
+
+	Shard&                      shard = this->shard( id );
+	std::lock_guard<std::mutex> lock( shard.mutex );
+
+	*generation = DocumentCache::generation( shard, ns );
+
+	EntryIndex::iterator i = shard.index.find( id );
+
+	if( i == shard.index.end() ) {
+		m_misses++;
+		return DocumentPtr();
+	}
+
+	Entries::iterator entry = i->second;
+
+	// Documents fetched before an invalidation are dropped lazily.
+	if( entry->generation != *generation || entry->expires <= std::chrono::steady_clock::now() ) {
+		erase( shard, entry );
+		m_misses++;
+		return DocumentPtr();
+	}
+
+	shard.lru.splice( shard.lru.begin(), shard.lru, entry );
+	m_hits++;
+
+	return entry->document;
+}
+
+// ** DocumentCache::put
+void DocumentCache::put( const std::string& ns, const std::string& key, const DocumentPtr& document, uint64_t generation )
+{
+	size_t entryLimit = std::max( m_options.maxEntries / m_options.shards, ( size_t )1 );
+	size_t byteLimit  = m_options.maxBytes / m_options.shards;
+	size_t bytes      = document->value()->len;
+
+	if( bytes > byteLimit ) {
+		return;
+	}
+
+	std::string id = ns;
+	id += '\0';
+	id += key;
+
+	Shard&                      shard = this->shard( id );
+	std::lock_guard<std::mutex> lock( shard.mutex );
+
+	// A write happened while the document was fetched, so it may be already stale.
+	if( DocumentCache::generation( shard, ns ) != generation ) {
+		return;
+	}
+
+	EntryIndex::iterator i = shard.index.find( id );
+
+	if( i != shard.index.end() ) {
+		erase( shard, i->second );
+	}
+
+	Entry entry;
+	entry.key        = id;
+	entry.document   = document;
+	entry.bytes      = bytes;
+	entry.generation = generation;
+	entry.expires    = std::chrono::steady_clock::now() + std::chrono::milliseconds( m_options.ttlMs );
+
+	shard.lru.push_front( entry );
+	shard.index[id] = shard.lru.begin();
+	shard.bytes += bytes;
+
+	while( shard.lru.size() > entryLimit || shard.bytes > byteLimit ) {
+		erase( shard, --shard.lru.end() );
+		m_evictions++;
+	}
+}
+
+// ** DocumentCache::invalidate
+void DocumentCache::invalidate( const std::string& ns )
+{
+	for( uint32_t i = 0; i < m_options.shards; i++ ) {
+		std::lock_guard<std::mutex> lock( m_shards[i].mutex );
+		m_shards[i].generations[ns]++;
+	}
+
+	m_invalidations++;
+}
+
+// ** DocumentCache::clear
+void DocumentCache::clear( void )
+{
+	for( uint32_t i = 0; i < m_options.shards; i++ ) {
+		std::lock_guard<std::mutex> lock( m_shards[i].mutex );
+		m_shards[i].lru.clear();
+		m_shards[i].index.clear();
+		m_shards[i].bytes = 0;
+	}
+}
+
+// ** DocumentCache::stats
+DocumentCache::Stats DocumentCache::stats( void ) const
+{
+	Stats stats;
+	stats.hits          = m_hits;
+	stats.misses        = m_misses;
+	stats.evictions     = m_evictions;
+	stats.invalidations = m_invalidations;
+	stats.entries       = 0;
+	stats.bytes         = 0;
+
+	for( uint32_t i = 0; i < m_options.shards; i++ ) {
+		std::lock_guard<std::mutex> lock( m_shards[i].mutex );
+		stats.entries += m_shards[i].index.size();
+		stats.bytes   += m_shards[i].bytes;
+	}
+
+	return stats;
+}
+
+} // namespace mongo
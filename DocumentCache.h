@@ -0,0 +1,155 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_DocumentCache_H__
+#define __Mongocpp_DocumentCache_H__
+
+#include "Mongo.h"
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+namespace mongo {
+
+	typedef std::shared_ptr<class DocumentCache> DocumentCachePtr;
+
+	//! Thread-safe read-through cache of documents returned by Collection::findOne.
+	/*!
+	Entries are distributed over independently locked shards, each shard evicts the least
+	recently used entries when its share of an entry or byte limit is exceeded, and entries
+	expire after a TTL. A cache can be shared by any number of Collection instances, for
+	example by collections of connections checked out from a ConnectionPool. Entries are
+	keyed by a collection namespace and query bytes, and writes through any collection
+	attached to a cache invalidate entries of its namespace.
+
+	Cached documents are shared between all readers without copying, so they must be treated
+	as immutable: Document::enableIndex must not be called on them.
+	*/
+	class DocumentCache {
+	public:
+
+		//! Cache limits.
+		struct Options {
+								Options( void )
+									: maxEntries( 10000 ), maxBytes( 64 * 1024 * 1024 ), ttlMs( 60000 ), shards( 16 ) {}
+
+			size_t				maxEntries;	//!< Maximum number of cached documents.
+			size_t				maxBytes;	//!< Maximum total size of cached documents.
+			uint32_t			ttlMs;		//!< Lifetime of a cached document in milliseconds.
+			uint32_t			shards;		//!< Number of independently locked shards.
+		};
+
+		//! Cache usage statistics.
+		struct Stats {
+			uint64_t			hits;			//!< Number of lookups that returned a document.
+			uint64_t			misses;			//!< Number of lookups that found nothing or an expired document.
+			uint64_t			evictions;		//!< Number of documents evicted by entry or byte limits.
+			uint64_t			invalidations;	//!< Number of namespace invalidations.
+			size_t				entries;		//!< Number of cached documents.
+			size_t				bytes;			//!< Total size of cached documents.
+		};
+
+								//! Constructs DocumentCache instance.
+								DocumentCache( const Options& options = Options() );
+
+		//! Returns a cached document or NULL.
+		/*!
+		\param ns Collection namespace.
+		\param key Query key.
+		\param generation Receives the namespace generation to pass to put after a document is fetched.
+		*/
+		DocumentPtr				get( const std::string& ns, const std::string& key, uint64_t* generation );
+
+		//! Caches a document unless its namespace was invalidated after the matching get.
+		void					put( const std::string& ns, const std::string& key, const DocumentPtr& document, uint64_t generation );
+
+		//! Invalidates all cached documents of a namespace.
+		void					invalidate( const std::string& ns );
+
+		//! Removes all cached documents.
+		void					clear( void );
+
+		//! Returns cache usage statistics.
+		Stats					stats( void ) const;
+
+	private:
+
+		//! Cached document.
+		struct Entry {
+			std::string								key;		//!< Namespace and query key.
+			DocumentPtr								document;	//!< Shared document.
+			size_t									bytes;		//!< Document size.
+			uint64_t								generation;	//!< Namespace generation the document was fetched at.
+			std::chrono::steady_clock::time_point	expires;	//!< Expiration time.
+		};
+
+		typedef std::list<Entry>								Entries;
+		typedef std::unordered_map<std::string, Entries::iterator>	EntryIndex;
+		typedef std::unordered_map<std::string, uint64_t>		Generations;
+
+		//! Independently locked part of a cache.
+		struct Shard {
+								Shard( void ) : bytes( 0 ) {}
+
+			std::mutex			mutex;			//!< Guards a shard.
+			Entries				lru;			//!< Entries ordered from the most to the least recently used.
+			EntryIndex			index;			//!< Entries by key.
+			Generations			generations;	//!< Namespace generations, bumped by invalidation.
+			size_t				bytes;			//!< Total size of cached documents.
+		};
+
+		//! Returns a shard that holds a key.
+		Shard&					shard( const std::string& key );
+
+		//! Removes an entry from a shard.
+		static void				erase( Shard& shard, Entries::iterator entry );
+
+		//! Returns a current namespace generation of a shard.
+		static uint64_t			generation( const Shard& shard, const std::string& ns );
+
+	private:
+
+		//! Cache limits.
+		Options					m_options;
+
+		//! Cache shards.
+		std::unique_ptr<Shard[]>	m_shards;
+
+		//! Statistics counters.
+		std::atomic<uint64_t>	m_hits;
+		std::atomic<uint64_t>	m_misses;
+		std::atomic<uint64_t>	m_evictions;
+		std::atomic<uint64_t>	m_invalidations;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_DocumentCache_H__	*/
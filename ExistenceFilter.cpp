@@ -0,0 +1,471 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "ExistenceFilter.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace mongo {
+
+//! Finalizes a 64-bit hash, so all bits depend on all input bits.
+static uint64_t mix64( uint64_t value )
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
+
+// ** ExistenceFilter::ExistenceFilter
+ExistenceFilter::ExistenceFilter( const Options& options )
+	: m_field( options.field ), m_seeded( false ), m_seeding( false ), m_stale( false ), m_pendingWrites( 0 ), m_seedEpoch( 0 ), m_rejected( 0 )
+{
+	const double ln2 = 0.69314718055994530942;
+
+	double items = ( double )std::max( options.expectedItems, ( uint64_t )1 );
+	double rate  = std::min( std::max( options.falsePositiveRate, 1e-9 ), 0.5 );
+
+	// The optimal number of counters is -n * ln( p ) / ln( 2 )^2, one byte each.
+	double optimal = ceil( -items * log( rate ) / ( ln2 * ln2 ) );
+
+	m_size      = std::max( std::min( ( size_t )optimal, options.maxBytes ), ( size_t )64 );
+	m_hashCount = ( uint32_t )std::min( std::max( floor( m_size / items * ln2 + 0.5 ), 1.0 ), 16.0 );
+	m_counters.reset( new std::atomic<uint8_t>[m_size]() );
+}
+
+// ** ExistenceFilter::field
+const std::string& ExistenceFilter::field( void ) const
+{
+	return m_field;
+}
+
+// ** ExistenceFilter::isReady
+bool ExistenceFilter::isReady( void ) const
+{
+	return m_seeded && !m_stale;
+}
+
+// ** ExistenceFilter::markStale
+void ExistenceFilter::markStale( void )
+{
+	m_stale = true;
+}
+
+// ** ExistenceFilter::rejected
+uint64_t ExistenceFilter::rejected( void ) const
+{
+	return m_rejected;
+}
+
+// ** ExistenceFilter::size
+size_t ExistenceFilter::size( void ) const
+{
+	return m_size;
+}
+
+// ** ExistenceFilter::hashCount
+uint32_t ExistenceFilter::hashCount( void ) const
+{
+	return m_hashCount;
+}
+
+// ** ExistenceFilter::add
+void ExistenceFilter::add( const OID& value )
+{
+	increment( hashKey( BsonObjectId, value.bytes(), 12 ) );
+}
+
+// ** ExistenceFilter::add
+void ExistenceFilter::add( int64_t value )
+{
+	increment( hashKey( BsonInt64, &value, sizeof( value ) ) );
+}
+
+// ** ExistenceFilter::add
+void ExistenceFilter::add( const std::string& value )
+{
+	increment( hashKey( BsonString, value.c_str(), value.length() ) );
+}
+
+// ** ExistenceFilter::mayContain
+bool ExistenceFilter::mayContain( const OID& value ) const
+{
+	return !isReady() || test( hashKey( BsonObjectId, value.bytes(), 12 ) );
+}
+
+// ** ExistenceFilter::mayContain
+bool ExistenceFilter::mayContain( int64_t value ) const
+{
+	return !isReady() || test( hashKey( BsonInt64, &value, sizeof( value ) ) );
+}
+
+// ** ExistenceFilter::mayContain
+bool ExistenceFilter::mayContain( const std::string& value ) const
+{
+	return !isReady() || test( hashKey( BsonString, value.c_str(), value.length() ) );
+}
+
+// ** ExistenceFilter::rejects
+bool ExistenceFilter::rejects( const BSON& query ) const
+{
+	if( !isReady() ) {
+		return false;
+	}
+
+	// Top-level conditions are combined with AND, so a missing key value rejects the whole query.
+	Iter     value;
+	uint64_t hash;
+
+	if( !findKey( query, value ) || !hashValue( value, &hash ) || test( hash ) ) {
+		return false;
+	}
+
+	m_rejected++;
+	return true;
+}
+
+// ** ExistenceFilter::beginSeed
+void ExistenceFilter::beginSeed( void )
+{
+	m_seeding = true;
+	m_seeded  = false;
+	m_stale   = false;
+	m_seedEpoch++;
+
+	for( size_t i = 0; i < m_size; i++ ) {
+		m_counters[i].store( 0, std::memory_order_relaxed );
+	}
+
+	// A write that added its key before counters were reset may be invisible to the scan, so the seed can't be trusted.
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	if( m_pendingWrites > 0 ) {
+		m_stale = true;
+	}
+}
+
+// ** ExistenceFilter::endSeed
+void ExistenceFilter::endSeed( bool success )
+{
+	m_seeded  = success;
+	m_seeding = false;
+}
+
+// ** ExistenceFilter::clear
+void ExistenceFilter::clear( void )
+{
+	for( size_t i = 0; i < m_size; i++ ) {
+		m_counters[i].store( 0, std::memory_order_relaxed );
+	}
+
+	// A dropped collection is known to be empty.
+	m_seeded = true;
+	m_stale  = false;
+}
+
+// ** ExistenceFilter::add
+void ExistenceFilter::add( const Iter& value )
+{
+	uint64_t hash;
+
+	if( hashValue( value, &hash ) ) {
+		increment( hash );
+		return;
+	}
+
+	// Decimals may equal integer keys and array elements are matched by equality lookups, neither is tracked.
+	if( value.type() == BsonDecimal128 || value.type() == BsonArray ) {
+		markStale();
+	}
+}
+
+// ** ExistenceFilter::remove
+void ExistenceFilter::remove( const Iter& value, int64_t count, uint64_t epoch )
+{
+	uint64_t hash;
+
+	// A key removed while or before seeding may be not counted, so it is left in place.
+	if( m_seeding || m_seedEpoch != epoch || !hashValue( value, &hash ) ) {
+		return;
+	}
+
+	for( int64_t i = 0; i < count; i++ ) {
+		decrement( hash );
+	}
+}
+
+// ** ExistenceFilter::beginWrite
+void ExistenceFilter::beginWrite( void )
+{
+	m_pendingWrites++;
+}
+
+// ** ExistenceFilter::endWrite
+void ExistenceFilter::endWrite( void )
+{
+	m_pendingWrites--;
+}
+
+// ** ExistenceFilter::seedEpoch
+uint64_t ExistenceFilter::seedEpoch( void ) const
+{
+	return m_seedEpoch;
+}
+
+// ** ExistenceFilter::inserted
+bool ExistenceFilter::inserted( const BSON& document )
+{
+	for( Iter i = document.iter(); i.isValid(); i.next() ) {
+		if( m_field == i.key() ) {
+			add( i );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ** ExistenceFilter::updated
+bool ExistenceFilter::updated( const BSON& query, const BSON& update, bool upsert )
+{
+	Iter key;
+	bool keyed = false;
+
+	// An upserted document receives equality values of a query.
+	if( upsert && findKey( query, key ) ) {
+		add( key );
+		keyed = true;
+	}
+
+	Iter first = update.iter();
+
+	if( !first.isValid() ) {
+		return keyed;
+	}
+
+	// A replacement document sets a key like an inserted one.
+	if( first.key()[0] != '$' ) {
+		return inserted( update ) || keyed;
+	}
+
+	size_t length = m_field.length();
+
+	for( Iter op = first; op.isValid(); op.next() ) {
+		if( op.type() != BsonObject ) {
+			continue;
+		}
+
+		bool assigns = strcmp( op.key(), "$set" ) == 0 || strcmp( op.key(), "$setOnInsert" ) == 0;
+		bool clears  = strcmp( op.key(), "$unset" ) == 0;
+		bool renames = strcmp( op.key(), "$rename" ) == 0;
+
+		for( Iter path = op.recurse(); path.isValid(); path.next() ) {
+			if( renames && path.type() == BsonString && m_field == path.toString() ) {
+				markStale();
+				continue;
+			}
+
+			const char* name = path.key();
+
+			if( strncmp( name, m_field.c_str(), length ) != 0 || ( name[length] != '\0' && name[length] != '.' ) ) {
+				continue;
+			}
+
+			// Assigned values are added, an unset key leaves a false positive, other modifiers produce unknown values.
+			if( assigns && name[length] == '\0' ) {
+				add( path );
+				keyed = true;
+			} else if( !clears ) {
+				markStale();
+			}
+		}
+	}
+
+	return keyed;
+}
+
+// ** ExistenceFilter::upserted
+void ExistenceFilter::upserted( const bson_t* reply, bool keyed )
+{
+	bson_iter_t iter;
+
+	// Only _id is generated by a server, other key fields are absent from documents that don't set them.
+	if( m_field != "_id" ) {
+		return;
+	}
+
+	if( reply && bson_iter_init_find( &iter, reply, "upserted" ) && BSON_ITER_HOLDS_ARRAY( &iter ) ) {
+		for( Iter entry = Iter( &iter ).recurse(); entry.isValid(); entry.next() ) {
+			for( Iter field = entry.toObject().iter(); field.isValid(); field.next() ) {
+				if( strcmp( field.key(), "_id" ) == 0 ) {
+					add( field );
+				}
+			}
+		}
+		return;
+	}
+
+	if( keyed ) {
+		return;
+	}
+
+	// Only an acknowledged reply proves that an existing document was updated instead of an unreported insert.
+	if( reply && bson_iter_init_find( &iter, reply, "nUpserted" ) && bson_iter_as_int64( &iter ) == 0 ) {
+		return;
+	}
+
+	markStale();
+}
+
+// ** ExistenceFilter::findKey
+bool ExistenceFilter::findKey( const BSON& query, Iter& value ) const
+{
+	if( query.raw() == NULL ) {
+		return false;
+	}
+
+	for( Iter i = query.iter(); i.isValid(); i.next() ) {
+		if( m_field == i.key() ) {
+			// Operator conditions like $in are not equality lookups.
+			if( i.type() == BsonObject || i.type() == BsonArray ) {
+				return false;
+			}
+
+			value = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ** ExistenceFilter::hashValue
+bool ExistenceFilter::hashValue( const Iter& value, uint64_t* hash )
+{
+	switch( value.type() ) {
+	case BsonInt32:
+	case BsonInt64:		{
+							int64_t integer = value.toInt64();
+							*hash = hashKey( BsonInt64, &integer, sizeof( integer ) );
+						}
+						return true;
+
+	case BsonDouble:	{
+							// Integral doubles equal integers on a server, so they share a key.
+							double number = value.toDouble();
+
+							if( number == floor( number ) && number >= -9.2e18 && number <= 9.2e18 ) {
+								int64_t integer = ( int64_t )number;
+								*hash = hashKey( BsonInt64, &integer, sizeof( integer ) );
+							} else {
+								*hash = hashKey( BsonDouble, &number, sizeof( number ) );
+							}
+						}
+						return true;
+
+	case BsonString:	{
+							const char* text = value.toString();
+							*hash = hashKey( BsonString, text, strlen( text ) );
+						}
+						return true;
+
+	case BsonObjectId:	{
+							OID oid = value.toObjectId();
+							*hash = hashKey( BsonObjectId, oid.bytes(), 12 );
+						}
+						return true;
+
+	default:			return false;
+	}
+}
+
+// ** ExistenceFilter::hashKey
+uint64_t ExistenceFilter::hashKey( uint8_t tag, const void* data, size_t size )
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>( data );
+	uint64_t       hash  = 14695981039346656037ULL;
+
+	hash = ( hash ^ tag ) * 1099511628211ULL;
+
+	for( size_t i = 0; i < size; i++ ) {
+		hash = ( hash ^ bytes[i] ) * 1099511628211ULL;
+	}
+
+	return mix64( hash );
+}
+
+// ** ExistenceFilter::increment
+void ExistenceFilter::increment( uint64_t hash )
+{
+	// Counter indices are derived from two hashes as h1 + i * h2.
+	uint64_t step = mix64( hash ^ 0x9e3779b97f4a7c15ULL ) | 1;
+
+	for( uint32_t i = 0; i < m_hashCount; i++ ) {
+		std::atomic<uint8_t>& counter = m_counters[( hash + i * step ) % m_size];
+		uint8_t               value   = counter.load( std::memory_order_relaxed );
+
+		while( value != 255 && !counter.compare_exchange_weak( value, value + 1, std::memory_order_relaxed ) ) {
+		}
+	}
+}
+
+// ** ExistenceFilter::decrement
+void ExistenceFilter::decrement( uint64_t hash )
+{
+	uint64_t step = mix64( hash ^ 0x9e3779b97f4a7c15ULL ) | 1;
+
+	for( uint32_t i = 0; i < m_hashCount; i++ ) {
+		std::atomic<uint8_t>& counter = m_counters[( hash + i * step ) % m_size];
+		uint8_t               value   = counter.load( std::memory_order_relaxed );
+
+		// A saturated counter lost its exact value, so it is never decremented.
+		while( value != 0 && value != 255 && !counter.compare_exchange_weak( value, value - 1, std::memory_order_relaxed ) ) {
+		}
+	}
+}
+
+// ** ExistenceFilter::test
+bool ExistenceFilter::test( uint64_t hash ) const
+{
+	uint64_t step = mix64( hash ^ 0x9e3779b97f4a7c15ULL ) | 1;
+
+	for( uint32_t i = 0; i < m_hashCount; i++ ) {
+		if( m_counters[( hash + i * step ) % m_size].load( std::memory_order_relaxed ) == 0 ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace mongo
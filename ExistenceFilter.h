@@ -0,0 +1,192 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_ExistenceFilter_H__
+#define __Mongocpp_ExistenceFilter_H__
+
+#include "MongoBson.h"
+
+namespace mongo {
+
+	typedef std::shared_ptr<class ExistenceFilter> ExistenceFilterPtr;
+
+	//! Counting Bloom filter that answers "definitely missing" for key lookups without a round trip.
+	/*!
+	A filter tracks values of a single top-level key field, usually _id or another unique
+	field. It is seeded from a projected collection scan and kept current by writes made
+	through collections it is attached to: inserted keys are added, keys of exactly removed
+	documents are decremented, and keys that updates may assign are added. Writes that can't
+	be tracked, such as bulk operations, mark the filter stale, so it stops rejecting lookups
+	until it is seeded again. A filter never reports a false negative for tracked writes,
+	writes made by other clients are not tracked.
+
+	Integer and integral double values are normalized to 64-bit integers, so they are matched
+	like the server matches them. Strings and ObjectIds are supported as well. Counters are
+	8-bit and saturate, a saturated counter is never decremented.
+	*/
+	class ExistenceFilter {
+	friend class Collection;
+	public:
+
+		//! Filter configuration.
+		struct Options {
+								Options( void )
+									: field( "_id" ), expectedItems( 1000000 ), falsePositiveRate( 0.01 ), maxBytes( 16 * 1024 * 1024 ) {}
+
+			std::string			field;				//!< Tracked top-level key field.
+			uint64_t			expectedItems;		//!< Expected number of distinct keys.
+			double				falsePositiveRate;	//!< Target false positive rate at the expected number of keys.
+			size_t				maxBytes;			//!< Memory budget, a filter is shrunk to fit it at the cost of a higher false positive rate.
+		};
+
+								//! Constructs ExistenceFilter instance, a filter rejects nothing until it is seeded.
+								ExistenceFilter( const Options& options = Options() );
+
+		//! Returns a tracked field name.
+		const std::string&		field( void ) const;
+
+		//! Returns true if a filter is seeded and not stale.
+		bool					isReady( void ) const;
+
+		//! Marks a filter stale, so it rejects nothing until it is seeded again.
+		void					markStale( void );
+
+		//! Adds a key.
+		void					add( const OID& value );
+		void					add( int64_t value );
+		void					add( const std::string& value );
+
+		//! Returns false if a key is definitely missing.
+		bool					mayContain( const OID& value ) const;
+		bool					mayContain( int64_t value ) const;
+		bool					mayContain( const std::string& value ) const;
+
+		//! Returns true if a query is an equality lookup of a key that is definitely missing.
+		bool					rejects( const BSON& query ) const;
+
+		//! Returns the number of lookups rejected by a filter.
+		uint64_t				rejected( void ) const;
+
+		//! Returns the number of counters, which is also a memory size in bytes.
+		size_t					size( void ) const;
+
+		//! Returns the number of hash functions.
+		uint32_t				hashCount( void ) const;
+
+	private:
+
+		//! Resets counters and starts seeding, a filter is stale after seeding if a tracked write was in flight.
+		void					beginSeed( void );
+
+		//! Finishes seeding.
+		void					endSeed( bool success );
+
+		//! Resets counters of an empty collection.
+		void					clear( void );
+
+		//! Adds a key value, unsupported values that could match a key lookup mark a filter stale.
+		void					add( const Iter& value );
+
+		//! Removes a key value a number of times, skipped if a filter was seeded since a removal started.
+		void					remove( const Iter& value, int64_t count, uint64_t epoch );
+
+		//! Registers a write that adds keys before it is sent, so a concurrent seed can't lose them.
+		void					beginWrite( void );
+
+		//! Unregisters a write once a server has applied it.
+		void					endWrite( void );
+
+		//! Returns the number of started seeds, captured by removals before they are sent.
+		uint64_t				seedEpoch( void ) const;
+
+		//! Adds a key of an inserted document, returns false if a document has no key field.
+		bool					inserted( const BSON& document );
+
+		//! Adds keys that an update may assign, returns true if a key of an upserted document is known.
+		bool					updated( const BSON& query, const BSON& update, bool upsert );
+
+		//! Adds identifiers generated by a server for upserted documents.
+		/*!
+		\param reply Write reply, NULL for unacknowledged writes.
+		\param keyed Flag returned by updated, a filter is marked stale if a server may have generated an unreported key.
+		*/
+		void					upserted( const bson_t* reply, bool keyed );
+
+		//! Finds an equality value of a tracked field in a query.
+		bool					findKey( const BSON& query, Iter& value ) const;
+
+		//! Hashes a supported key value, returns false for unsupported value types.
+		static bool				hashValue( const Iter& value, uint64_t* hash );
+
+		//! Hashes tagged key bytes.
+		static uint64_t			hashKey( uint8_t tag, const void* data, size_t size );
+
+		//! Increments or decrements counters of a key hash.
+		void					increment( uint64_t hash );
+		void					decrement( uint64_t hash );
+
+		//! Returns true if all counters of a key hash are set.
+		bool					test( uint64_t hash ) const;
+
+	private:
+
+		//! Tracked field name.
+		std::string				m_field;
+
+		//! Number of counters.
+		size_t					m_size;
+
+		//! Number of hash functions.
+		uint32_t				m_hashCount;
+
+		//! Saturating 8-bit counters.
+		std::unique_ptr<std::atomic<uint8_t>[]>	m_counters;
+
+		//! Flag indicating that a filter is seeded.
+		std::atomic<bool>		m_seeded;
+
+		//! Flag indicating that a filter is being seeded, decrements are skipped while seeding.
+		std::atomic<bool>		m_seeding;
+
+		//! Flag indicating that an untracked write happened.
+		std::atomic<bool>		m_stale;
+
+		//! Number of writes that added keys and are not applied by a server yet.
+		std::atomic<uint32_t>	m_pendingWrites;
+
+		//! Number of started seeds.
+		std::atomic<uint64_t>	m_seedEpoch;
+
+		//! Number of rejected lookups.
+		mutable std::atomic<uint64_t>	m_rejected;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_ExistenceFilter_H__	*/
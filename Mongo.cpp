@@ -31,107 +31,881 @@
 #include "MongoBson.h"
 #include "Collection.h"
 
+#include <algorithm>
+#include <type_traits>
+#include <mutex>
+#include <chrono>
+
 namespace mongo {
 
-// ** Connection::Connection
-Connection::Connection( const std::string& host, const std::string& db ) : m_db( db )
+//! Initializes the MongoDB driver once per process.
+static void initialize( void )
+{
+    static std::once_flag once;
+    std::call_once( once, mongoc_init );
+}
+
+// ** Connection::Connection
+Connection::Connection( const std::string& host, const std::string& db ) : m_db( db ), m_pool( NULL )
+{
+    initialize();
+    m_client = mongoc_client_new( host.c_str() );
+}
+
+// ** Connection::Connection
+Connection::Connection( ConnectionPool* pool, mongoc_client_t* client, const std::string& db ) : m_db( db ), m_client( client ), m_pool( pool )
+{
+
+}
+
+Connection::~Connection( void )
+{
+    if( m_pool ) {
+        if( m_pooledWriteConcern.isSet() ) {
+            mongoc_client_set_write_concern( m_client, m_pooledWriteConcern.raw() );
+        }
+        m_pool->release( m_client );
+    } else {
+        mongoc_client_destroy( m_client );
+    }
+}
+
+// ** Connection::collection
+CollectionPtr Connection::collection( const std::string& name )
+{
+    return CollectionPtr( new Collection( m_pool, m_client, m_db, mongoc_client_get_collection( m_client, m_db.c_str(), name.c_str() ) ) );
+}
+
+// ** Connection::setWriteConcern
+void Connection::setWriteConcern( const WriteConcern& writeConcern )
+{
+    // A pooled client keeps its settings after it is returned, so the original write concern is saved to be restored.
+    if( m_pool && !m_pooledWriteConcern.isSet() ) {
+        m_pooledWriteConcern = WriteConcern( mongoc_write_concern_copy( mongoc_client_get_write_concern( m_client ) ) );
+    }
+
+    mongoc_client_set_write_concern( m_client, writeConcern.raw() );
+}
+
+// ** ConnectionPool::ConnectionPool
+ConnectionPool::ConnectionPool( const std::string& uri, const std::string& db, uint32_t minSize, uint32_t maxSize )
+    : m_pool( NULL ), m_db( db ), m_minSize( std::min( minSize, maxSize ) ), m_maxSize( maxSize )
+    , m_acquired( 0 ), m_waited( 0 ), m_totalWaitUs( 0 ), m_maxWaitUs( 0 ), m_inUse( 0 )
+{
+    initialize();
+
+    mongoc_uri_t* parsed = mongoc_uri_new( uri.c_str() );
+
+    if( !parsed ) {
+        printf( "ConnectionPool::ConnectionPool : invalid URI %s\n", uri.c_str() );
+        return;
+    }
+
+    m_pool = mongoc_client_pool_new( parsed );
+    mongoc_uri_destroy( parsed );
+
+    mongoc_client_pool_max_size( m_pool, m_maxSize );
+
+    if( m_minSize ) {
+        warmUp();
+    }
+}
+
+ConnectionPool::~ConnectionPool( void )
+{
+    assert( m_inUse == 0 );
+
+    if( m_pool ) {
+        mongoc_client_pool_destroy( m_pool );
+    }
+}
+
+// ** ConnectionPool::acquire
+ConnectionPtr ConnectionPool::acquire( void )
+{
+    if( !m_pool ) {
+        return ConnectionPtr();
+    }
+
+    mongoc_client_t* client = mongoc_client_pool_try_pop( m_pool );
+
+    if( !client ) {
+        // All clients are in use, wait for a free one and account the wait time.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        client = mongoc_client_pool_pop( m_pool );
+        uint64_t us = ( uint64_t )std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start ).count();
+
+        m_waited++;
+        m_totalWaitUs += us;
+
+        uint64_t longest = m_maxWaitUs;
+        while( us > longest && !m_maxWaitUs.compare_exchange_weak( longest, us ) ) {
+            // compare_exchange_weak reloads the longest wait on failure.
+        }
+    }
+
+    m_acquired++;
+    m_inUse++;
+
+    return ConnectionPtr( new Connection( this, client, m_db ) );
+}
+
+// ** ConnectionPool::tryAcquire
+ConnectionPtr ConnectionPool::tryAcquire( void )
+{
+    mongoc_client_t* client = m_pool ? mongoc_client_pool_try_pop( m_pool ) : NULL;
+
+    if( !client ) {
+        return ConnectionPtr();
+    }
+
+    m_acquired++;
+    m_inUse++;
+
+    return ConnectionPtr( new Connection( this, client, m_db ) );
+}
+
+// ** ConnectionPool::release
+void ConnectionPool::release( mongoc_client_t* client )
+{
+    m_inUse--;
+    mongoc_client_pool_push( m_pool, client );
+}
+
+// ** ConnectionPool::warmUp
+bool ConnectionPool::warmUp( void )
+{
+    if( !m_pool ) {
+        return false;
+    }
+
+    std::vector<mongoc_client_t*> clients;
+    bool                          result = true;
+    bson_t*                       ping   = BCON_NEW( "ping", BCON_INT32( 1 ) );
+
+    // Clients are checked out at the same time, so each ping opens a separate connection.
+    for( uint32_t i = 0; i < m_minSize; i++ ) {
+        mongoc_client_t* client = mongoc_client_pool_pop( m_pool );
+        bson_error_t     err;
+
+        if( !mongoc_client_command_simple( client, "admin", ping, NULL, NULL, &err ) ) {
+            printf( "ConnectionPool::warmUp : %s\n", err.message );
+            result = false;
+        }
+
+        clients.push_back( client );
+    }
+
+    for( size_t i = 0; i < clients.size(); i++ ) {
+        mongoc_client_pool_push( m_pool, clients[i] );
+    }
+
+    bson_destroy( ping );
+    return result;
+}
+
+// ** ConnectionPool::stats
+ConnectionPool::Stats ConnectionPool::stats( void ) const
+{
+    Stats result;
+
+    result.acquired     = m_acquired;
+    result.waited       = m_waited;
+    result.totalWaitUs  = m_totalWaitUs;
+    result.maxWaitUs    = m_maxWaitUs;
+    result.inUse        = m_inUse;
+
+    return result;
+}
+
+// ** BulkOperation::BulkOperation
+BulkOperation::BulkOperation( mongoc_bulk_operation_t* bulk, const std::function<void()>& invalidate ) : m_bulk( bulk ), m_invalidate( invalidate )
+{
+
+}
+
+BulkOperation::~BulkOperation( void )
+{
+    mongoc_bulk_operation_destroy( m_bulk );
+}
+
+// ** WriteConcern::WriteConcern
+WriteConcern::WriteConcern( void )
+{
+
+}
+
+// ** WriteConcern::WriteConcern
+WriteConcern::WriteConcern( mongoc_write_concern_t* concern ) : m_concern( concern, mongoc_write_concern_destroy )
+{
+
+}
+
+// ** WriteConcern::acknowledged
+WriteConcern WriteConcern::acknowledged( void )
+{
+    return w( 1 );
+}
+
+// ** WriteConcern::unacknowledged
+WriteConcern WriteConcern::unacknowledged( void )
+{
+    return w( MONGOC_WRITE_CONCERN_W_UNACKNOWLEDGED );
+}
+
+// ** WriteConcern::journaled
+WriteConcern WriteConcern::journaled( void )
+{
+    mongoc_write_concern_t* concern = mongoc_write_concern_new();
+    mongoc_write_concern_set_w( concern, 1 );
+    mongoc_write_concern_set_journal( concern, true );
+    return WriteConcern( concern );
+}
+
+// ** WriteConcern::majority
+WriteConcern WriteConcern::majority( int32_t timeoutMs )
+{
+    mongoc_write_concern_t* concern = mongoc_write_concern_new();
+    mongoc_write_concern_set_wmajority( concern, timeoutMs );
+    return WriteConcern( concern );
+}
+
+// ** WriteConcern::w
+WriteConcern WriteConcern::w( int32_t nodes, int32_t timeoutMs )
+{
+    mongoc_write_concern_t* concern = mongoc_write_concern_new();
+    mongoc_write_concern_set_w( concern, nodes );
+
+    if( timeoutMs ) {
+        mongoc_write_concern_set_wtimeout( concern, timeoutMs );
+    }
+
+    return WriteConcern( concern );
+}
+
+// ** WriteConcern::isSet
+bool WriteConcern::isSet( void ) const
+{
+    return m_concern != NULL;
+}
+
+// ** WriteConcern::raw
+const mongoc_write_concern_t* WriteConcern::raw( void ) const
+{
+    return m_concern.get();
+}
+
+// ** BulkOperation::insert
+void BulkOperation::insert( const BSON& document )
+{
+    mongoc_bulk_operation_insert( m_bulk, document.raw() );
+}
+
+// ** BulkOperation::updateOne
+void BulkOperation::updateOne( const BSON& query, const BSON& update, bool upsert )
+{
+    mongoc_bulk_operation_update_one( m_bulk, query.raw(), update.raw(), upsert );
+}
+
+// ** BulkOperation::updateMany
+void BulkOperation::updateMany( const BSON& query, const BSON& update, bool upsert )
+{
+    mongoc_bulk_operation_update( m_bulk, query.raw(), update.raw(), upsert );
+}
+
+// ** BulkOperation::update
+void BulkOperation::update( const BSON& query, const BSON& value )
+{
+    if( isOperatorDocument( value ) ) {
+        updateOne( query, value );
+    } else {
+        replaceOne( query, value );
+    }
+}
+
+// ** BulkOperation::upsert
+void BulkOperation::upsert( const BSON& query, const BSON& value )
+{
+    if( isOperatorDocument( value ) ) {
+        updateOne( query, value, true );
+    } else {
+        replaceOne( query, value, true );
+    }
+}
+
+// ** BulkOperation::isOperatorDocument
+bool BulkOperation::isOperatorDocument( const BSON& document )
+{
+    // A bulk update only accepts $-operators, while a whole document is queued as a replacement.
+    bson_iter_t iter;
+    return document.raw() && bson_iter_init( &iter, document.raw() ) && bson_iter_next( &iter ) && bson_iter_key( &iter )[0] == '$';
+}
+
+// ** BulkOperation::replaceOne
+void BulkOperation::replaceOne( const BSON& query, const BSON& document, bool upsert )
+{
+    mongoc_bulk_operation_replace_one( m_bulk, query.raw(), document.raw(), upsert );
+}
+
+// ** BulkOperation::removeOne
+void BulkOperation::removeOne( const BSON& query )
+{
+    mongoc_bulk_operation_remove_one( m_bulk, query.raw() );
+}
+
+// ** BulkOperation::removeMany
+void BulkOperation::removeMany( const BSON& query )
+{
+    mongoc_bulk_operation_remove( m_bulk, query.raw() );
+}
+
+// ** BulkOperation::execute
+bool BulkOperation::execute( BulkResult* result )
+{
+    bson_error_t err;
+    bson_t       reply;
+    bool         success = mongoc_bulk_operation_execute( m_bulk, &reply, &err ) != 0;
+
+    // Even a failed bulk operation may have written some documents.
+    if( m_invalidate ) {
+        m_invalidate();
+    }
+
+    if( result ) {
+        *result = BulkResult();
+
+        for( Iter field( &reply ); field.isValid(); field.next() ) {
+            const char* key = field.key();
+
+            if( strcmp( key, "nInserted" ) == 0 )       result->nInserted = field.toInt64();
+            else if( strcmp( key, "nMatched" ) == 0 )   result->nMatched  = field.toInt64();
+            else if( strcmp( key, "nModified" ) == 0 )  result->nModified = field.toInt64();
+            else if( strcmp( key, "nUpserted" ) == 0 )  result->nUpserted = field.toInt64();
+            else if( strcmp( key, "nRemoved" ) == 0 )   result->nRemoved  = field.toInt64();
+            else if( strcmp( key, "writeErrors" ) == 0 ) {
+                for( Iter item = field.recurse(); item.isValid(); item.next() ) {
+                    DocumentView          error = item.toObject();
+                    BulkResult::WriteError writeError;
+
+                    writeError.index   = 0;
+                    writeError.code    = 0;
+                    writeError.message = "";
+
+                    for( Iter value = error.iter(); value.isValid(); value.next() ) {
+                        if( strcmp( value.key(), "index" ) == 0 )        writeError.index   = ( uint32_t )value.toInt64();
+                        else if( strcmp( value.key(), "code" ) == 0 )    writeError.code    = ( int )value.toInt64();
+                        else if( strcmp( value.key(), "errmsg" ) == 0 )  writeError.message = value.toString();
+                    }
+
+                    result->writeErrors.push_back( writeError );
+                }
+            }
+            else if( strcmp( key, "writeConcernErrors" ) == 0 ) {
+                for( Iter item = field.recurse(); item.isValid(); item.next() ) {
+                    DocumentView                  error = item.toObject();
+                    BulkResult::WriteConcernError writeConcernError;
+
+                    writeConcernError.code    = 0;
+                    writeConcernError.message = "";
+
+                    for( Iter value = error.iter(); value.isValid(); value.next() ) {
+                        if( strcmp( value.key(), "code" ) == 0 )         writeConcernError.code    = ( int )value.toInt64();
+                        else if( strcmp( value.key(), "errmsg" ) == 0 )  writeConcernError.message = value.toString();
+                    }
+
+                    result->writeConcernErrors.push_back( writeConcernError );
+                }
+            }
+        }
+
+        if( !success ) {
+            result->error = err.message;
+        }
+    }
+    else if( !success ) {
+        printf( "BulkOperation::execute : %s\n", err.message );
+    }
+
+    bson_destroy( &reply );
+    return success;
+}
+
+// ** Cursor::Cursor
+Cursor::Cursor( mongoc_cursor_t* cursor ) : m_cursor( cursor )
+{
+
+}
+
+Cursor::~Cursor( void )
+{
+    mongoc_cursor_destroy( m_cursor );
+}
+
+// ** Cursor::clone
+CursorPtr Cursor::clone( void )
+{
+    return CursorPtr( new Cursor( mongoc_cursor_clone( m_cursor ) ) );
+}
+
+// ** Cursor::next
+DocumentPtr Cursor::next( void )
+{
+    return nextView().toOwned();
+}
+
+// ** Cursor::nextView
+DocumentView Cursor::nextView( void )
+{
+    const bson_t* doc;
+    if( !mongoc_cursor_next( m_cursor, &doc ) ) {
+        return DocumentView();
+    }
+
+    return DocumentView( doc );
+}
+
+// ** Cursor::begin
+Cursor::Iterator Cursor::begin( void )
+{
+    return Iterator( this );
+}
+
+// ** Cursor::end
+Cursor::Iterator Cursor::end( void )
+{
+    return Iterator( NULL );
+}
+
+// ** Cursor::Iterator::Iterator
+Cursor::Iterator::Iterator( Cursor* cursor ) : m_cursor( cursor )
+{
+    if( m_cursor ) {
+        m_view = m_cursor->nextView();
+    }
+}
+
+// ** Cursor::Iterator::operator *
+const DocumentView& Cursor::Iterator::operator * ( void ) const
+{
+    return m_view;
+}
+
+// ** Cursor::Iterator::operator ->
+const DocumentView* Cursor::Iterator::operator -> ( void ) const
+{
+    return &m_view;
+}
+
+// ** Cursor::Iterator::operator ++
+Cursor::Iterator& Cursor::Iterator::operator ++ ( void )
+{
+    m_view = m_cursor->nextView();
+    return *this;
+}
+
+// ** Cursor::Iterator::operator !=
+bool Cursor::Iterator::operator != ( const Iterator& other ) const
+{
+    return m_view.isNull() != other.m_view.isNull();
+}
+
+// ** Document::Document
+Document::Document( bson_t* document ) : m_document( document )
+{
+
+}
+
+Document::~Document( void )
+{
+    bson_destroy( m_document );
+}
+
+// ** Document::value
+bson_t* Document::value( void ) const
+{
+    return m_document;
+}
+
+// ** Document::view
+DocumentView Document::view( void ) const
+{
+    return DocumentView( m_document, m_index.get() );
+}
+
+// ** Document::enableIndex
+void Document::enableIndex( void )
+{
+    if( !m_index ) {
+        m_index.reset( new FieldIndex );
+    }
+}
+
+// ** Document::_id
+OID Document::_id( void ) const
+{
+    return view()._id();
+}
+
+// ** Document::string
+std::string Document::string( const char* key ) const
+{
+    return view().string( key );
+}
+
+// ** Document::objectId
+OID Document::objectId( const char* key ) const
+{
+    return view().objectId( key );
+}
+
+// ** Document::number
+double Document::number( const char* key ) const
+{
+    return view().number( key );
+}
+
+// ** Document::integer
+int Document::integer( const char* key ) const
+{
+    return view().integer( key );
+}
+
+// ** Document::int64
+int64_t Document::int64( const char* key ) const
+{
+    return view().int64( key );
+}
+
+// ** Document::dateTime
+DateTime Document::dateTime( const char* key ) const
+{
+    return view().dateTime( key );
+}
+
+// ** Document::binary
+Binary Document::binary( const char* key ) const
+{
+    return view().binary( key );
+}
+
+// ** Document::decimal
+Decimal128 Document::decimal( const char* key ) const
+{
+    return view().decimal( key );
+}
+
+// ** Document::array
+DocumentView Document::array( const char* key ) const
+{
+    return view().array( key );
+}
+
+// ** Document::object
+DocumentView Document::object( const char* key ) const
+{
+    return view().object( key );
+}
+
+// ** Document::keys
+StringSet Document::keys( void ) const
+{
+    return view().keys();
+}
+
+// ** Document::integerSet
+IntegerSet Document::integerSet( const char* key ) const
+{
+    return view().integerSet( key );
+}
+
+// ** Document::numbers
+FloatArray Document::numbers( const char* key ) const
+{
+    return view().numbers( key );
+}
+
+// ** Document::strings
+StringArray Document::strings( const char* key ) const
+{
+    return view().strings( key );
+}
+
+// ** Document::integers
+IntegerArray Document::integers( const char* key ) const
+{
+    return view().integers( key );
+}
+
+// ** Document::doubles
+DoubleArray Document::doubles( const char* key ) const
+{
+    return view().doubles( key );
+}
+
+// ** Document::arraySize
+uint32_t Document::arraySize( const char* key ) const
+{
+    return view().arraySize( key );
+}
+
+// ** Document::numbers
+uint32_t Document::numbers( const char* key, double* values, uint32_t capacity ) const
+{
+    return view().numbers( key, values, capacity );
+}
+
+// ** Document::numbers
+uint32_t Document::numbers( const char* key, float* values, uint32_t capacity ) const
+{
+    return view().numbers( key, values, capacity );
+}
+
+// ** Document::numbers
+uint32_t Document::numbers( const char* key, int32_t* values, uint32_t capacity ) const
+{
+    return view().numbers( key, values, capacity );
+}
+
+// ** Document::numbers
+uint32_t Document::numbers( const char* key, int64_t* values, uint32_t capacity ) const
+{
+    return view().numbers( key, values, capacity );
+}
+
+//! Returns the number of elements in an array field.
+static uint32_t countElements( const bson_iter_t* field )
+{
+    bson_iter_t i;
+    uint32_t    count = 0;
+
+    if( bson_iter_type( field ) != BSON_TYPE_ARRAY || !bson_iter_recurse( field, &i ) ) {
+        return 0;
+    }
+
+    while( bson_iter_next( &i ) ) {
+        count++;
+    }
+
+    return count;
+}
+
+//! Reads a little-endian numeric payload of an array element.
+static inline double  readDouble( const uint8_t* data ) { uint64_t value; memcpy( &value, data, 8 ); value = BSON_UINT64_FROM_LE( value ); double result; memcpy( &result, &value, 8 ); return result; }
+static inline int32_t readInt32( const uint8_t* data )  { uint32_t value; memcpy( &value, data, 4 ); return ( int32_t )BSON_UINT32_FROM_LE( value ); }
+static inline int64_t readInt64( const uint8_t* data )  { uint64_t value; memcpy( &value, data, 8 ); return ( int64_t )BSON_UINT64_FROM_LE( value ); }
+
+//! Array element decoding state.
+struct ArrayCursor {
+    const uint8_t*  data;       //!< Current element.
+    const uint8_t*  end;        //!< Terminating zero of an array.
+    uint32_t        index;      //!< Current element index.
+    uint32_t        digits;     //!< The number of digits in the current index key.
+    uint32_t        nextDigit;  //!< Index at which the key becomes one digit longer.
+};
+
+//! Decodes a run of array elements of the same type.
+/*!
+Array keys are decimal element indices, so the payload offset of each element is known without
+scanning a key, which turns the loop into a fixed-stride copy. Returns when an element of another
+type is met, a key is not a plain index or a buffer is full.
+*/
+template<typename TValue, int Type, int Size>
+static void decodeRun( ArrayCursor& cursor, TValue* values, uint32_t capacity )
+{
+    while( cursor.index < capacity ) {
+        const uint8_t* payload = cursor.data + cursor.digits + 2;
+
+        if( payload + Size > cursor.end || cursor.data[0] != Type || cursor.data[cursor.digits + 1] != 0 ) {
+            return;
+        }
+
+        switch( Type ) {
+        case BSON_TYPE_DOUBLE:  values[cursor.index] = ( TValue )readDouble( payload );
+                                break;
+        case BSON_TYPE_INT32:   values[cursor.index] = ( TValue )readInt32( payload );
+                                break;
+        case BSON_TYPE_INT64:   values[cursor.index] = ( TValue )readInt64( payload );
+                                break;
+        }
+
+        cursor.data = payload + Size;
+
+        if( ++cursor.index == cursor.nextDigit ) {
+            cursor.digits++;
+            cursor.nextDigit *= 10;
+        }
+    }
+}
+
+//! Decodes numeric array elements to a buffer, returns the number of decoded elements.
+template<typename TValue>
+static uint32_t decodeNumbers( const bson_iter_t* field, TValue* values, uint32_t capacity )
+{
+    if( bson_iter_type( field ) != BSON_TYPE_ARRAY ) {
+        return 0;
+    }
+
+    const uint8_t* data;
+    uint32_t       length;
+    bson_iter_array( field, &length, &data );
+
+    ArrayCursor cursor;
+    cursor.data      = data + 4;
+    cursor.end       = data + length - 1;
+    cursor.index     = 0;
+    cursor.digits    = 1;
+    cursor.nextDigit = 10;
+
+    // Homogeneous arrays are decoded by a single run, mixed numeric arrays switch between runs.
+    while( cursor.index < capacity && cursor.data < cursor.end ) {
+        uint32_t index = cursor.index;
+
+        switch( cursor.data[0] ) {
+        case BSON_TYPE_DOUBLE:  decodeRun<TValue, BSON_TYPE_DOUBLE, 8>( cursor, values, capacity );
+                                break;
+        case BSON_TYPE_INT32:   decodeRun<TValue, BSON_TYPE_INT32, 4>( cursor, values, capacity );
+                                break;
+        case BSON_TYPE_INT64:   decodeRun<TValue, BSON_TYPE_INT64, 8>( cursor, values, capacity );
+                                break;
+        }
+
+        if( cursor.index == index ) {
+            break;
+        }
+    }
+
+    if( cursor.index == capacity || cursor.data >= cursor.end ) {
+        return cursor.index;
+    }
+
+    // Fall back to the BSON iterator for non-numeric elements and unusual keys.
+    bson_iter_t i;
+    uint32_t    count = 0;
+
+    bson_iter_recurse( field, &i );
+
+    while( count < capacity && bson_iter_next( &i ) ) {
+        if( count++ < cursor.index ) {
+            continue;
+        }
+
+        switch( bson_iter_type( &i ) ) {
+        case BSON_TYPE_DOUBLE:  values[count - 1] = ( TValue )bson_iter_double( &i );
+                                break;
+        case BSON_TYPE_INT32:   values[count - 1] = ( TValue )bson_iter_int32( &i );
+                                break;
+        case BSON_TYPE_INT64:   values[count - 1] = ( TValue )bson_iter_int64( &i );
+                                break;
+        default:                values[count - 1] = TValue();
+        }
+    }
+
+    return count;
+}
+
+// ** DocumentView::DocumentView
+DocumentView::DocumentView( void ) : m_data( NULL ), m_length( 0 ), m_index( NULL )
 {
-    mongoc_init();
-    m_client = mongoc_client_new( host.c_str() );
+
 }
 
-Connection::~Connection( void )
+// ** DocumentView::DocumentView
+DocumentView::DocumentView( const bson_t* document ) : m_data( NULL ), m_length( 0 ), m_index( NULL )
 {
-    mongoc_client_destroy( m_client );
+    if( document ) {
+        m_data   = bson_get_data( document );
+        m_length = document->len;
+    }
 }
 
-// ** Connection::collection
-CollectionPtr Connection::collection( const std::string& name )
+// ** DocumentView::DocumentView
+DocumentView::DocumentView( const bson_t* document, FieldIndex* index ) : m_data( NULL ), m_length( 0 ), m_index( index )
 {
-    return CollectionPtr( new Collection( mongoc_client_get_collection( m_client, m_db.c_str(), name.c_str() ) ) );
+    if( document ) {
+        m_data   = bson_get_data( document );
+        m_length = document->len;
+    }
 }
 
-// ** BulkOperation::BulkOperation
-BulkOperation::BulkOperation( mongoc_bulk_operation_t* bulk ) : m_bulk( bulk )
+// ** DocumentView::DocumentView
+DocumentView::DocumentView( const uint8_t* data, uint32_t length ) : m_data( data ), m_length( length ), m_index( NULL )
 {
 
 }
 
-BulkOperation::~BulkOperation( void )
+// ** DocumentView::isNull
+bool DocumentView::isNull( void ) const
 {
-    mongoc_bulk_operation_destroy( m_bulk );
+    return m_data == NULL;
 }
 
-// ** BulkOperation::insert
-void BulkOperation::insert( const BSON& document )
+// ** DocumentView::data
+const uint8_t* DocumentView::data( void ) const
 {
-    mongoc_bulk_operation_insert( m_bulk, document.raw() );
+    return m_data;
 }
 
-// ** BulkOperation::execute
-bool BulkOperation::execute( void )
+// ** DocumentView::length
+uint32_t DocumentView::length( void ) const
 {
-    bson_error_t err;
-
-    if( !mongoc_bulk_operation_execute( m_bulk, NULL, &err ) ) {
-        printf( "BulkOperation::execute : %s\n", err.message );
-        return false;
-    }
-
-    return true;
+    return m_length;
 }
 
-// ** Cursor::Cursor
-Cursor::Cursor( mongoc_cursor_t* cursor ) : m_cursor( cursor )
+// ** DocumentView::toOwned
+DocumentPtr DocumentView::toOwned( void ) const
 {
+    if( !m_data ) {
+        return DocumentPtr();
+    }
 
+    return DocumentPtr( new Document( bson_new_from_data( m_data, m_length ) ) );
 }
 
-Cursor::~Cursor( void )
+// ** DocumentView::iter
+Iter DocumentView::iter( void ) const
 {
-    mongoc_cursor_destroy( m_cursor );
+    return Iter( m_data, m_length );
 }
 
-// ** Cursor::clone
-CursorPtr Cursor::clone( void )
+// ** DocumentView::begin
+Iter DocumentView::begin( void ) const
 {
-    return CursorPtr( new Cursor( mongoc_cursor_clone( m_cursor ) ) );
+    return Iter( m_data, m_length );
 }
 
-// ** Cursor::next
-DocumentPtr Cursor::next( void )
+// ** DocumentView::end
+Iter DocumentView::end( void ) const
 {
-    const bson_t* doc;
-    if( !mongoc_cursor_next( m_cursor, &doc ) ) {
-        return NULL;
-    }
-
-    return DocumentPtr( new Document( bson_copy( doc ) ) );
+    return Iter();
 }
 
-// ** Document::Document
-Document::Document( bson_t* document ) : m_document( document )
+// ** DocumentView::find
+bool DocumentView::find( const char* key, bson_iter_t* field ) const
 {
+    if( !m_data ) {
+        return false;
+    }
 
-}
+    if( m_index ) {
+        return m_index->find( m_data, m_length, key, field );
+    }
 
-Document::~Document( void )
-{
-    bson_destroy( m_document );
+    bson_iter_t iter;
+    return bson_iter_init_from_data( &iter, m_data, m_length ) && bson_iter_find_descendant( &iter, key, field );
 }
 
-// ** Document::_id
-OID Document::_id( void ) const
+// ** DocumentView::_id
+OID DocumentView::_id( void ) const
 {
     return objectId( "_id" );
 }
 
-// ** Document::string
-std::string Document::string( const char* key ) const
+// ** DocumentView::string
+std::string DocumentView::string( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_UTF8 );
         return bson_iter_utf8( &field, NULL );
     }
@@ -139,26 +913,26 @@ std::string Document::string( const char* key ) const
     return "";
 }
 
-// ** Document::objectId
-OID Document::objectId( const char* key ) const
+// ** DocumentView::objectId
+OID DocumentView::objectId( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_OID );
         const bson_oid_t* oid = bson_iter_oid( &field );
-        return OID( oid ? *oid : bson_oid_t() );
+        return oid ? OID( *oid ) : OID();
     }
 
-    return OID( bson_oid_t() );
+    return OID();
 }
 
-// ** Document::number
-double Document::number( const char* key ) const
+// ** DocumentView::number
+double DocumentView::number( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_DOUBLE );
         return bson_iter_double( &field );
     }
@@ -166,12 +940,12 @@ double Document::number( const char* key ) const
     return 0.0;
 }
 
-// ** Document::integer
-int Document::integer( const char* key ) const
+// ** DocumentView::integer
+int DocumentView::integer( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_INT32 );
         return bson_iter_int32( &field );
     }
@@ -179,47 +953,112 @@ int Document::integer( const char* key ) const
     return 0;
 }
 
+// ** DocumentView::int64
+int64_t DocumentView::int64( const char* key ) const
+{
+    bson_iter_t field;
+
+    if( find( key, &field ) ) {
+        assert( bson_iter_type( &field ) == BSON_TYPE_INT64 || bson_iter_type( &field ) == BSON_TYPE_INT32 );
+        return bson_iter_type( &field ) == BSON_TYPE_INT32 ? bson_iter_int32( &field ) : bson_iter_int64( &field );
+    }
 
-// ** Document::value
-bson_t* Document::value( void ) const
+    return 0;
+}
+
+// ** DocumentView::dateTime
+DateTime DocumentView::dateTime( const char* key ) const
 {
-    return m_document;
+    bson_iter_t field;
+
+    if( find( key, &field ) ) {
+        assert( bson_iter_type( &field ) == BSON_TYPE_DATE_TIME );
+        return DateTime( bson_iter_date_time( &field ) );
+    }
+
+    return DateTime();
 }
 
-// ** Document::array
-DocumentPtr Document::array( const char* key ) const
+// ** DocumentView::binary
+Binary DocumentView::binary( const char* key ) const
+{
+    bson_iter_t field;
+
+    if( find( key, &field ) ) {
+        assert( bson_iter_type( &field ) == BSON_TYPE_BINARY );
+
+        bson_subtype_t subtype;
+        Binary         result;
+
+        bson_iter_binary( &field, &subtype, &result.length, &result.data );
+        result.subtype = ( uint8_t )subtype;
+
+        return result;
+    }
+
+    return Binary();
+}
+
+// ** DocumentView::decimal
+Decimal128 DocumentView::decimal( const char* key ) const
+{
+    bson_iter_t       field;
+    bson_decimal128_t value;
+    Decimal128        result;
+
+    if( find( key, &field ) && bson_iter_decimal128( &field, &value ) ) {
+        result.high = value.high;
+        result.low  = value.low;
+    }
+
+    return result;
+}
+
+// ** DocumentView::array
+DocumentView DocumentView::array( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_ARRAY );
-        
+
         const uint8_t* data;
         uint32_t       length;
-        bson_t         array;
 
         bson_iter_array( &field, &length, &data );
-        bson_init_static( &array, data, length );
-
-        return DocumentPtr( new Document( bson_copy( &array ) ) );
+        return DocumentView( data, length );
     }
 
-    return NULL;
+    return DocumentView();
 }
 
-// ** Document::object
-DocumentPtr Document::object( const char* key ) const
+// ** DocumentView::object
+DocumentView DocumentView::object( const char* key ) const
 {
-	return DocumentPtr();
+    bson_iter_t field;
+
+    if( find( key, &field ) ) {
+        assert( bson_iter_type( &field ) == BSON_TYPE_DOCUMENT );
+
+        const uint8_t* data;
+        uint32_t       length;
+
+        bson_iter_document( &field, &length, &data );
+        return DocumentView( data, length );
+    }
+
+    return DocumentView();
 }
 
-// ** Document::keys
-StringSet Document::keys( void ) const
+// ** DocumentView::keys
+StringSet DocumentView::keys( void ) const
 {
     StringSet   result;
     bson_iter_t iter;
 
-    bson_iter_init( &iter, m_document );
+    if( !m_data || !bson_iter_init_from_data( &iter, m_data, m_length ) ) {
+        return result;
+    }
 
     while( bson_iter_next( &iter ) ) {
         result.insert( bson_iter_key( &iter ) );
@@ -228,56 +1067,112 @@ StringSet Document::keys( void ) const
     return result;
 }
 
-// ** Document::integerSet
-IntegerSet Document::integerSet( const char* key ) const
+// ** DocumentView::integerSet
+IntegerSet DocumentView::integerSet( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
     IntegerSet  result;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_ARRAY );
 
         bson_iter_t i;
         bson_iter_recurse( &field, &i );
 
+        // Arrays are usually stored sorted, so inserting with an end hint is amortized constant.
         while( bson_iter_next( &i ) ) {
             assert( bson_iter_type( &i ) == BSON_TYPE_INT32 );
-            result.insert( bson_iter_int32( &i ) );
+            result.insert( result.end(), bson_iter_int32( &i ) );
         }
     }
     
     return result;
 }
 
-// ** Document::numbers
-FloatArray Document::numbers( const char* key ) const
+// ** DocumentView::numbers
+FloatArray DocumentView::numbers( const char* key ) const
 {
-    bson_iter_t iter, field;
+    bson_iter_t field;
     FloatArray  result;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
-        assert( bson_iter_type( &field ) == BSON_TYPE_ARRAY );
+    if( find( key, &field ) ) {
+        result.resize( countElements( &field ) );
+        result.resize( decodeNumbers( &field, result.data(), ( uint32_t )result.size() ) );
+    }
 
-        bson_iter_t i;
-        bson_iter_recurse( &field, &i );
+    return result;
+}
 
-        while( bson_iter_next( &i ) ) {
-            assert( bson_iter_type( &i ) == BSON_TYPE_DOUBLE );
-            result.push_back( ( float )bson_iter_double( &i ) );
-        }
+// ** DocumentView::integers
+IntegerArray DocumentView::integers( const char* key ) const
+{
+    bson_iter_t  field;
+    IntegerArray result;
+
+    if( find( key, &field ) ) {
+        result.resize( countElements( &field ) );
+        result.resize( decodeNumbers( &field, result.data(), ( uint32_t )result.size() ) );
     }
-    
+
     return result;
 }
 
+// ** DocumentView::doubles
+DoubleArray DocumentView::doubles( const char* key ) const
+{
+    bson_iter_t field;
+    DoubleArray result;
 
-// ** Document::strings
-StringArray Document::strings( const char* key ) const
+    if( find( key, &field ) ) {
+        result.resize( countElements( &field ) );
+        result.resize( decodeNumbers( &field, result.data(), ( uint32_t )result.size() ) );
+    }
+
+    return result;
+}
+
+// ** DocumentView::arraySize
+uint32_t DocumentView::arraySize( const char* key ) const
+{
+    bson_iter_t field;
+    return find( key, &field ) ? countElements( &field ) : 0;
+}
+
+// ** DocumentView::numbers
+uint32_t DocumentView::numbers( const char* key, double* values, uint32_t capacity ) const
+{
+    bson_iter_t field;
+    return find( key, &field ) ? decodeNumbers( &field, values, capacity ) : 0;
+}
+
+// ** DocumentView::numbers
+uint32_t DocumentView::numbers( const char* key, float* values, uint32_t capacity ) const
+{
+    bson_iter_t field;
+    return find( key, &field ) ? decodeNumbers( &field, values, capacity ) : 0;
+}
+
+// ** DocumentView::numbers
+uint32_t DocumentView::numbers( const char* key, int32_t* values, uint32_t capacity ) const
+{
+    bson_iter_t field;
+    return find( key, &field ) ? decodeNumbers( &field, values, capacity ) : 0;
+}
+
+// ** DocumentView::numbers
+uint32_t DocumentView::numbers( const char* key, int64_t* values, uint32_t capacity ) const
+{
+    bson_iter_t field;
+    return find( key, &field ) ? decodeNumbers( &field, values, capacity ) : 0;
+}
+
+// ** DocumentView::strings
+StringArray DocumentView::strings( const char* key ) const
 {
-    bson_iter_t iter, field;
-    StringArray  result;
+    bson_iter_t field;
+    StringArray result;
 
-    if( bson_iter_init( &iter, m_document ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+    if( find( key, &field ) ) {
         assert( bson_iter_type( &field ) == BSON_TYPE_ARRAY );
 
         bson_iter_t i;
@@ -293,51 +1188,340 @@ StringArray Document::strings( const char* key ) const
     return result;
 }
 
+//! Location of a document element resolved by a FieldIndex.
+struct FieldLocation {
+    uint32_t    container;
+    uint32_t    containerLength;
+    uint32_t    offset;
+    uint32_t    keyLength;
+};
+
+//! Resolves a key by walking a document, dotted paths descend into nested documents and arrays.
+static bool locateField( const uint8_t* data, uint32_t length, const char* key, FieldLocation& location, bson_iter_t* field )
+{
+    const uint8_t* container       = data;
+    uint32_t       containerLength = length;
+
+    location.container       = 0;
+    location.containerLength = 0;
+    location.offset          = 0;
+    location.keyLength       = 0;
+
+    for( const char* segment = key; ; ) {
+        const char* dot    = strchr( segment, '.' );
+        size_t      size   = dot ? dot - segment : strlen( segment );
+        bson_iter_t iter;
+
+        if( !bson_iter_init_from_data( &iter, container, containerLength ) || !bson_iter_find_w_len( &iter, segment, ( int )size ) ) {
+            return false;
+        }
+
+        if( !dot ) {
+            location.container       = ( uint32_t )( container - data );
+            location.containerLength = containerLength;
+            location.offset          = bson_iter_offset( &iter );
+            location.keyLength       = bson_iter_key_len( &iter );
+            *field = iter;
+            return true;
+        }
+
+        switch( bson_iter_type( &iter ) ) {
+        case BSON_TYPE_DOCUMENT:    bson_iter_document( &iter, &containerLength, &container );
+                                    break;
+        case BSON_TYPE_ARRAY:       bson_iter_array( &iter, &containerLength, &container );
+                                    break;
+        default:                    return false;
+        }
+
+        segment = dot + 1;
+    }
+
+    return false;
+}
+
+// ** FieldIndex::FieldIndex
+FieldIndex::FieldIndex( void ) : m_count( 0 )
+{
+
+}
+
+// ** FieldIndex::clear
+void FieldIndex::clear( void )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+
+    m_entries.clear();
+    m_keys.clear();
+    m_count = 0;
+}
+
+// ** FieldIndex::find
+bool FieldIndex::find( const uint8_t* data, uint32_t length, const char* key, bson_iter_t* field )
+{
+    // FNV-1a hash of a key, the key length is calculated on the way.
+    uint64_t    hash = 14695981039346656037ULL;
+    const char* end  = key;
+
+    for( ; *end; end++ ) {
+        hash = ( hash ^ ( uint8_t )*end ) * 1099511628211ULL;
+    }
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+
+    if( m_entries.empty() ) {
+        m_entries.resize( 16 );
+        for( size_t i = 0; i < m_entries.size(); i++ ) {
+            m_entries[i].key = Empty;
+        }
+    }
+
+    size_t mask  = m_entries.size() - 1;
+    size_t index = ( size_t )hash & mask;
+
+    for( ; m_entries[index].key != Empty; index = ( index + 1 ) & mask ) {
+        const Entry& entry = m_entries[index];
+
+        if( entry.hash != hash || strcmp( m_keys.c_str() + entry.key, key ) != 0 ) {
+            continue;
+        }
+
+        if( entry.offset == Missing ) {
+            return false;
+        }
+
+        return bson_iter_init_from_data_at_offset( field, data + entry.container, entry.containerLength, entry.offset, entry.keyLength );
+    }
+
+    // The key is looked up for the first time, resolve and record it.
+    FieldLocation location;
+    bool          found = locateField( data, length, key, location, field );
+
+    Entry& entry            = m_entries[index];
+    entry.hash              = hash;
+    entry.key               = ( uint32_t )m_keys.size();
+    entry.offset            = found ? location.offset : ( uint32_t )Missing;
+    entry.container         = location.container;
+    entry.containerLength   = location.containerLength;
+    entry.keyLength         = location.keyLength;
+
+    m_keys.append( key, end - key + 1 );
+
+    if( ++m_count * 4 >= m_entries.size() * 3 ) {
+        grow();
+    }
+
+    return found;
+}
+
+// ** FieldIndex::grow
+void FieldIndex::grow( void )
+{
+    std::vector<Entry> entries( m_entries.size() * 2 );
+    size_t             mask = entries.size() - 1;
+
+    for( size_t i = 0; i < entries.size(); i++ ) {
+        entries[i].key = Empty;
+    }
+
+    for( size_t i = 0; i < m_entries.size(); i++ ) {
+        if( m_entries[i].key == Empty ) {
+            continue;
+        }
+
+        size_t index = ( size_t )m_entries[i].hash & mask;
+        while( entries[index].key != Empty ) {
+            index = ( index + 1 ) & mask;
+        }
+        entries[index] = m_entries[i];
+    }
+
+    m_entries.swap( entries );
+}
+
+// ** Decimal128::toString
+std::string Decimal128::toString( void ) const
+{
+    bson_decimal128_t value;
+    value.high = high;
+    value.low  = low;
+
+    char str[BSON_DECIMAL128_STRING];
+    bson_decimal128_to_string( &value, str );
+    return str;
+}
+
+// ** Decimal128::fromString
+Decimal128 Decimal128::fromString( const char* value )
+{
+    bson_decimal128_t decimal;
+    Decimal128        result;
+
+    bson_decimal128_from_string( value, &decimal );
+    result.high = decimal.high;
+    result.low  = decimal.low;
+
+    return result;
+}
+
+//! Hex digit pairs for each byte value.
+static const char s_hexDigits[] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+//! Returns a value of a hex digit or -1 for other characters.
+static inline int hexValue( char c )
+{
+    if( c >= '0' && c <= '9' ) return c - '0';
+    if( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+    if( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+    return -1;
+}
+
+// ** OID::OID
+OID::OID( void )
+{
+    static_assert( sizeof( OID ) == sizeof( bson_oid_t ), "OID should have the same layout as bson_oid_t" );
+    static_assert( std::is_trivially_copyable<OID>::value, "OID should be trivially copyable" );
+    memset( m_bytes, 0, sizeof( m_bytes ) );
+}
+
 // ** OID::OID
 OID::OID( const bson_oid_t& oid )
 {
-	bson_oid_copy( &oid, raw() );
+    memcpy( m_bytes, oid.bytes, sizeof( m_bytes ) );
 }
 
 // ** OID::OID
 OID::OID( const std::string& oid )
 {
-	assert( oid.length() == 24 );
-    bson_oid_init_from_string( raw(), oid.c_str() );
+    parse( oid.c_str(), oid.length() );
+}
+
+// ** OID::OID
+OID::OID( const char* oid )
+{
+    parse( oid, oid ? strlen( oid ) : 0 );
+}
+
+// ** OID::parse
+void OID::parse( const char* oid, size_t length )
+{
+    memset( m_bytes, 0, sizeof( m_bytes ) );
+
+    if( !oid || length != 24 ) {
+        return;
+    }
+
+    unsigned char bytes[12];
+
+    for( int i = 0; i < 12; i++ ) {
+        int high = hexValue( oid[i * 2 + 0] );
+        int low  = hexValue( oid[i * 2 + 1] );
+
+        if( high < 0 || low < 0 ) {
+            return;
+        }
+
+        bytes[i] = ( unsigned char )( ( high << 4 ) | low );
+    }
+
+    memcpy( m_bytes, bytes, sizeof( m_bytes ) );
 }
 
 // ** OID::raw
-bson_oid_t* OID::raw( void ) const
+const bson_oid_t* OID::raw( void ) const
 {
-	return m_oid.get();
+	return reinterpret_cast<const bson_oid_t*>( m_bytes );
 }
 
 // ** OID::generate
 OID OID::generate( void )
 {
-	bson_oid_t oid;
-	bson_oid_init( &oid, NULL );
-	return OID( oid );
+	OID result;
+	bson_oid_init( reinterpret_cast<bson_oid_t*>( result.m_bytes ), NULL );
+	return result;
+}
+
+// ** OID::generate
+std::vector<OID> OID::generate( size_t count )
+{
+    std::vector<OID> result( count );
+
+    for( size_t i = 0; i < count; i++ ) {
+        bson_oid_init( reinterpret_cast<bson_oid_t*>( result[i].m_bytes ), NULL );
+    }
+
+    return result;
 }
 
 // ** OID::bytes
 const unsigned char* OID::bytes( void ) const
 {
-	return m_oid->bytes;
+	return m_bytes;
 }
 
 // ** OID::toString
 std::string OID::toString( void ) const
 {
-    char str[64];
-    bson_oid_to_string( raw(), str );
-    return str;
+    char str[25];
+    toString( str );
+    return std::string( str, 24 );
+}
+
+// ** OID::toString
+void OID::toString( char* buffer ) const
+{
+    for( int i = 0; i < 12; i++ ) {
+        memcpy( buffer + i * 2, s_hexDigits + m_bytes[i] * 2, 2 );
+    }
+
+    buffer[24] = 0;
+}
+
+// ** OID::timestamp
+uint32_t OID::timestamp( void ) const
+{
+    // The first four bytes are a big-endian creation time.
+    return ( uint32_t( m_bytes[0] ) << 24 ) | ( uint32_t( m_bytes[1] ) << 16 ) | ( uint32_t( m_bytes[2] ) << 8 ) | uint32_t( m_bytes[3] );
+}
+
+// ** OID::hash
+size_t OID::hash( void ) const
+{
+    uint32_t words[3];
+    memcpy( words, m_bytes, sizeof( words ) );
+
+    // The counter in the last word varies the most, so all words are mixed.
+    uint64_t result = ( uint64_t( words[0] ) << 32 ) ^ ( uint64_t( words[1] ) << 16 ) ^ words[2];
+    result ^= result >> 33;
+    result *= 0xff51afd7ed558ccdULL;
+    result ^= result >> 33;
+
+    return ( size_t )result;
 }
 
 // ** OID::operator ==
 bool OID::operator == ( const OID& other ) const
 {
-    return bson_oid_equal( raw(), other.raw() );
+    return memcmp( m_bytes, other.m_bytes, sizeof( m_bytes ) ) == 0;
+}
+
+// ** OID::operator !=
+bool OID::operator != ( const OID& other ) const
+{
+    return memcmp( m_bytes, other.m_bytes, sizeof( m_bytes ) ) != 0;
+}
+
+// ** OID::operator <
+bool OID::operator < ( const OID& other ) const
+{
+    return memcmp( m_bytes, other.m_bytes, sizeof( m_bytes ) ) < 0;
 }
 
 } // namespace mongo
\ No newline at end of file
@@ -34,19 +34,26 @@
 	#include <bcon.h>
 #else
 	struct mongoc_client_t;
+	struct mongoc_client_pool_t;
 	struct mongoc_cursor_t;
 	struct mongoc_collection_t;
 	struct mongoc_bulk_operation_t;
+	struct mongoc_write_concern_t;
 
 	struct bson_t;
 	struct bson_oid_t;
 	struct bson_iter_t;
 #endif
 
+#include <stdint.h>
+
 #include <set>
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
 
 #define DOCUMENT( x )   (mongo::DocumentSelector() << x)
 #define ARRAY( x )      (mongo::ArraySelector()	   << x)
@@ -56,6 +63,7 @@
 namespace mongo {
 
     typedef std::shared_ptr<class Connection>       ConnectionPtr;
+    typedef std::shared_ptr<class ConnectionPool>   ConnectionPoolPtr;
     typedef std::shared_ptr<class Cursor>           CursorPtr;
     typedef std::shared_ptr<class Collection>       CollectionPtr;
     typedef std::shared_ptr<class Document>         DocumentPtr;
@@ -64,9 +72,12 @@ namespace mongo {
     typedef std::set<int>                           IntegerSet;
 	typedef std::vector<int>						IntegerArray;
     typedef std::vector<float>                      FloatArray;
+	typedef std::vector<double>						DoubleArray;
 	typedef std::vector<std::string>				StringArray;
+	typedef std::shared_ptr<std::atomic<uint64_t> >	WriteCounterPtr;
 
 	class BSON;
+	class Iter;
 
 	//! Converts an integer to a string.
 	inline std::string toString( int value )
@@ -81,20 +92,30 @@ namespace mongo {
 	}
 
     //! Class that wraps the MongoDB ObjectId type.
+	/*!
+	OID is a trivially copyable 12-byte value, so it can be stored in containers
+	without heap allocations. It is hashable and ordered by the byte representation.
+	*/
     class OID {
     public:
 
+								//! Constructs a zero ObjectId.
+								OID( void );
+
 								//! Constructs OID instance from BSON object id.
                                 OID( const bson_oid_t& oid );
 
-								//! Construcst OID instance from ObjectId string.
+								//! Construcst OID instance from ObjectId string, invalid strings produce a zero ObjectId.
                                 OID( const std::string& oid );
+								OID( const char* oid );
 
 		//! Compares two OID instances.
         bool                    operator == ( const OID& other ) const;
+		bool					operator != ( const OID& other ) const;
+		bool					operator < ( const OID& other ) const;
 
 		//! Returns the BSON ObjectId value.
-        bson_oid_t*				raw( void ) const;
+        const bson_oid_t*		raw( void ) const;
 
 		//! Returns a byte representation of an ObjectId.
 		const unsigned char*	bytes( void ) const;
@@ -102,28 +123,264 @@ namespace mongo {
 		//! Convers the ObjectId to a string.
         std::string             toString( void ) const;
 
+		//! Writes a 24 character hex string followed by a zero terminator to a buffer.
+		void					toString( char* buffer ) const;
+
+		//! Returns the ObjectId creation time in seconds since the Unix epoch.
+		uint32_t				timestamp( void ) const;
+
+		//! Returns the ObjectId hash value.
+		size_t					hash( void ) const;
+
 		//! Generates a new ObjectId.
 		static OID				generate( void );
 
+		//! Generates a batch of new ObjectIds.
+		static std::vector<OID>	generate( size_t count );
+
     private:
 
-		//! Internal BSON object id pointer type.
-		typedef std::shared_ptr<bson_oid_t> BsonObjectIdPtr;
+		//! Decodes an ObjectId from a hex string.
+		void					parse( const char* oid, size_t length );
+
+    private:
 
-		//! Actual object id.
-        BsonObjectIdPtr			m_oid;
+		//! ObjectId bytes.
+		unsigned char			m_bytes[12];
     };
 
+	//! UTC datetime value in milliseconds since the Unix epoch.
+	struct DateTime {
+		explicit				DateTime( int64_t milliseconds = 0 ) : milliseconds( milliseconds ) {}
+
+		int64_t					milliseconds;	//!< Milliseconds since the Unix epoch.
+	};
+
+	//! Binary value.
+	/*!
+	Binary values read from documents point directly into a document buffer
+	and are valid while the document is alive.
+	*/
+	struct Binary {
+								Binary( void ) : data( NULL ), length( 0 ), subtype( 0 ) {}
+								Binary( const uint8_t* data, uint32_t length, uint8_t subtype = 0 ) : data( data ), length( length ), subtype( subtype ) {}
+
+		const uint8_t*			data;		//!< Binary payload.
+		uint32_t				length;		//!< Payload length in bytes.
+		uint8_t					subtype;	//!< BSON binary subtype.
+	};
+
+	//! IEEE 754-2008 128-bit decimal value.
+	struct Decimal128 {
+								Decimal128( void ) : high( 0 ), low( 0 ) {}
+
+		//! Converts the decimal value to a string.
+		std::string				toString( void ) const;
+
+		//! Parses a decimal value from a string, returns NaN for invalid strings.
+		static Decimal128		fromString( const char* value );
+
+		uint64_t				high;	//!< High 64 bits.
+		uint64_t				low;	//!< Low 64 bits.
+	};
+
+	//! Lazily built index of document field locations.
+	/*!
+	Each looked up key (including dotted paths) is resolved once and its element offset
+	is recorded in a small open-addressing table, so repeated lookups jump straight to the value
+	instead of scanning the document from the beginning. Lookups record entries under a mutex,
+	so documents shared by a DocumentCache or SingleFlight can be read from several threads.
+	*/
+	class FieldIndex {
+	public:
+
+								//! Constructs an empty FieldIndex instance.
+								FieldIndex( void );
+
+		//! Finds a field inside a document buffer, the location is recorded on the first lookup.
+		bool					find( const uint8_t* data, uint32_t length, const char* key, bson_iter_t* field );
+
+		//! Removes all recorded locations.
+		void					clear( void );
+
+	private:
+
+		//! Grows the table and rehashes entries.
+		void					grow( void );
+
+	private:
+
+		//! Index table entry.
+		struct Entry {
+			uint64_t			hash;				//!< Key hash.
+			uint32_t			key;				//!< Key offset in a key storage, Empty for free entries.
+			uint32_t			container;			//!< Offset of the container document inside a root document.
+			uint32_t			containerLength;	//!< Length of the container document.
+			uint32_t			offset;				//!< Element offset inside a container, Missing for absent keys.
+			uint32_t			keyLength;			//!< Length of the last key path segment.
+		};
+
+		enum {
+			  Empty   = 0xFFFFFFFF	//!< Key offset of a free table entry.
+			, Missing = 0xFFFFFFFF	//!< Element offset of a key that is not present in a document.
+		};
+
+		//! Hash table entries.
+		std::vector<Entry>		m_entries;
+
+		//! Zero-terminated keys of recorded entries.
+		std::string				m_keys;
+
+		//! The number of used entries.
+		uint32_t				m_count;
+
+		//! Guards the table, so concurrent lookups don't race while recording entries.
+		std::mutex				m_mutex;
+	};
+
+	//! Non-owning view over a BSON document.
+	/*!
+	A view doesn't copy the document, so it is valid only while the underlying
+	buffer is alive. Use toOwned to keep the document around.
+	*/
+	class DocumentView {
+	public:
+
+								//! Constructs an empty view.
+								DocumentView( void );
+
+								//! Constructs a view over a BSON document.
+								DocumentView( const bson_t* document );
+
+								//! Constructs a view over a raw BSON buffer.
+								DocumentView( const uint8_t* data, uint32_t length );
+
+		//! Returns true if the view doesn't point to a document.
+		bool					isNull( void ) const;
+
+		//! Returns the raw document data.
+		const uint8_t*			data( void ) const;
+
+		//! Returns the document length in bytes.
+		uint32_t				length( void ) const;
+
+		//! Copies the viewed document to a new Document instance.
+		DocumentPtr				toOwned( void ) const;
+
+		//! Returns an iterator positioned at the first field.
+		Iter					iter( void ) const;
+
+		//! Returns an iterator to the first field, used by range-based for loops.
+		Iter					begin( void ) const;
+
+		//! Returns an end iterator.
+		Iter					end( void ) const;
+
+        OID                     _id( void ) const;
+        OID                     objectId( const char* key ) const;
+        std::string             string( const char* key ) const;
+        double                  number( const char* key ) const;
+        int                     integer( const char* key ) const;
+		int64_t					int64( const char* key ) const;
+		DateTime				dateTime( const char* key ) const;
+		Binary					binary( const char* key ) const;
+		Decimal128				decimal( const char* key ) const;
+        DocumentView            array( const char* key ) const;
+		DocumentView			object( const char* key ) const;
+        StringSet               keys( void ) const;
+        IntegerSet              integerSet( const char* key ) const;
+        FloatArray              numbers( const char* key ) const;
+		StringArray				strings( const char* key ) const;
+		IntegerArray			integers( const char* key ) const;
+		DoubleArray				doubles( const char* key ) const;
+
+		//! Returns the number of array elements.
+		uint32_t				arraySize( const char* key ) const;
+
+		//! Decodes numeric array elements into a caller-provided buffer.
+		/*!
+		Double, int32 and int64 elements are converted to a buffer type, other elements are decoded as zero.
+		\param key Array key.
+		\param values Output buffer.
+		\param capacity Maximum number of values to write.
+		\return The number of written values.
+		*/
+		uint32_t				numbers( const char* key, double* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, float* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, int32_t* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, int64_t* values, uint32_t capacity ) const;
+
+	private:
+
+		friend class Document;
+
+								//! Constructs a view that uses a field index for lookups.
+								DocumentView( const bson_t* document, FieldIndex* index );
+
+		//! Finds a field with a specified key, dotted paths are supported.
+		bool					find( const char* key, bson_iter_t* field ) const;
+
+	private:
+
+		//! Document data.
+		const uint8_t*			m_data;
+
+		//! Document length.
+		uint32_t				m_length;
+
+		//! Optional field index.
+		FieldIndex*				m_index;
+	};
+
     // ** class Cursor
     class Cursor {
     friend class Collection;
+    friend class PrefetchCursor;
     public:
 
+		//! Input iterator over documents returned by a cursor.
+		class Iterator {
+		public:
+
+								//! Constructs Iterator instance and fetches the first document.
+								Iterator( Cursor* cursor );
+
+			//! Returns the current document view.
+			const DocumentView&	operator * ( void ) const;
+			const DocumentView*	operator -> ( void ) const;
+
+			//! Fetches the next document.
+			Iterator&			operator ++ ( void );
+
+			//! Compares two iterators.
+			bool				operator != ( const Iterator& other ) const;
+
+		private:
+
+			//! Parent cursor.
+			Cursor*				m_cursor;
+
+			//! Current document.
+			DocumentView		m_view;
+		};
+
                                 ~Cursor( void );
 
         DocumentPtr             next( void );
         CursorPtr               clone( void );
 
+		//! Returns a borrowed view of the next document.
+		/*!
+		The view is valid until the cursor moves again, an empty view is returned at the end of a cursor.
+		*/
+		DocumentView			nextView( void );
+
+		//! Returns an iterator to the first document, used by range-based for loops.
+		Iterator				begin( void );
+
+		//! Returns an iterator to the end of a cursor.
+		Iterator				end( void );
+
     private:
 
                                 Cursor( mongoc_cursor_t* cursor );
@@ -133,6 +390,78 @@ namespace mongo {
         mongoc_cursor_t*        m_cursor;
     };
 
+	//! Write concern that controls how write operations are acknowledged.
+	/*!
+	An unset write concern inherits the collection default, which is inherited from a
+	connection and a connection string in turn. Unacknowledged writes don't wait for a
+	server reply, so they report success as soon as they are sent.
+	*/
+	class WriteConcern {
+	friend class Connection;
+	public:
+
+								//! Constructs an unset write concern.
+								WriteConcern( void );
+
+		//! Returns a write concern that waits for an acknowledgement of a primary (w:1).
+		static WriteConcern		acknowledged( void );
+
+		//! Returns a fire-and-forget write concern (w:0).
+		static WriteConcern		unacknowledged( void );
+
+		//! Returns a write concern that waits until a write is committed to a journal (w:1, j:true).
+		static WriteConcern		journaled( void );
+
+		//! Returns a write concern that waits for an acknowledgement of a majority of replica set members.
+		static WriteConcern		majority( int32_t timeoutMs = 0 );
+
+		//! Returns a write concern that waits for an acknowledgement of a specified number of replica set members.
+		static WriteConcern		w( int32_t nodes, int32_t timeoutMs = 0 );
+
+		//! Returns true if a write concern is set.
+		bool					isSet( void ) const;
+
+		//! Returns actual write concern pointer, NULL if a write concern is not set.
+		const mongoc_write_concern_t*	raw( void ) const;
+
+	private:
+
+								//! Constructs WriteConcern instance, takes ownership of a write concern.
+								WriteConcern( mongoc_write_concern_t* concern );
+
+	private:
+
+		//! Actual write concern, shared between copies.
+		std::shared_ptr<mongoc_write_concern_t>	m_concern;
+	};
+
+	//! Result of a bulk operation.
+	struct BulkResult {
+		//! Error of a single write inside a bulk operation.
+		struct WriteError {
+			uint32_t				index;		//!< Index of a failed operation.
+			int						code;		//!< Server error code.
+			std::string				message;	//!< Error message.
+		};
+
+		//! Write concern error reported after writes were applied.
+		struct WriteConcernError {
+			int						code;		//!< Server error code.
+			std::string				message;	//!< Error message.
+		};
+
+									BulkResult( void ) : nInserted( 0 ), nMatched( 0 ), nModified( 0 ), nUpserted( 0 ), nRemoved( 0 ) {}
+
+		int64_t						nInserted;		//!< Number of inserted documents.
+		int64_t						nMatched;		//!< Number of documents matched by updates.
+		int64_t						nModified;		//!< Number of modified documents.
+		int64_t						nUpserted;		//!< Number of upserted documents.
+		int64_t						nRemoved;		//!< Number of removed documents.
+		std::vector<WriteError>		writeErrors;	//!< Errors of individual operations.
+		std::vector<WriteConcernError>	writeConcernErrors;	//!< Write concern errors, writes were applied but not acknowledged as requested.
+		std::string					error;			//!< Error message of a failed bulk operation.
+	};
+
     // ** class BulkOperation
     class BulkOperation {
     friend class Collection;
@@ -140,20 +469,62 @@ namespace mongo {
 
                                     ~BulkOperation( void );
 
+		//! Queues a document insertion.
         void                        insert( const BSON& document );
-        bool                        execute( void );
+
+		//! Queues an update of the first document that matches a query.
+		void						updateOne( const BSON& query, const BSON& update, bool upsert = false );
+
+		//! Queues an update of all documents that match a query.
+		void						updateMany( const BSON& query, const BSON& update, bool upsert = false );
+
+		//! Queues an update of the first document that matches a query, mirrors Collection::update.
+		/*!
+		Documents that start with a $-operator are queued as an update, other documents replace a matched document.
+		*/
+		void						update( const BSON& query, const BSON& value );
+
+		//! Queues an update of the first matching document, a document is inserted if nothing matches.
+		/*!
+		Mirrors Collection::upsert, so both update operator documents and replacement documents are accepted.
+		*/
+		void						upsert( const BSON& query, const BSON& value );
+
+		//! Queues a replacement of the first document that matches a query.
+		void						replaceOne( const BSON& query, const BSON& document, bool upsert = false );
+
+		//! Queues a removal of the first document that matches a query.
+		void						removeOne( const BSON& query );
+
+		//! Queues a removal of all documents that match a query.
+		void						removeMany( const BSON& query );
+
+		//! Executes queued operations.
+		/*!
+		\param result Optional result that receives operation counters and write errors,
+		errors are printed when a result is not requested.
+		\return true if all operations succeeded.
+		*/
+        bool                        execute( BulkResult* result = NULL );
 
     private:
 
-                                    BulkOperation( mongoc_bulk_operation_t* bulk );
+                                    BulkOperation( mongoc_bulk_operation_t* bulk, const std::function<void()>& invalidate );
+
+		//! Returns true if the first key of a document is an update operator.
+		static bool					isOperatorDocument( const BSON& document );
 
     private:
 
         mongoc_bulk_operation_t*    m_bulk;
+
+		//! Invalidates caches of a parent collection on execution.
+		std::function<void()>		m_invalidate;
     };
 
     // ** class Connection
     class Connection {
+    friend class ConnectionPool;
     public:
 
                                 Connection( const std::string& host, const std::string& db );
@@ -161,15 +532,97 @@ namespace mongo {
 
         CollectionPtr           collection( const std::string& name );
 
+		//! Sets a default write concern for this connection, collections created after this call inherit it.
+		void					setWriteConcern( const WriteConcern& writeConcern );
+
+    private:
+
+								//! Constructs a connection that returns its client to a pool when destroyed.
+                                Connection( ConnectionPool* pool, mongoc_client_t* client, const std::string& db );
+
     private:
 
         std::string             m_db;
         mongoc_client_t*        m_client;
+
+		//! Parent pool of a checked out connection.
+		ConnectionPool*			m_pool;
+
+		//! Write concern of a pooled client that is restored when a connection is returned to a pool.
+		WriteConcern			m_pooledWriteConcern;
     };
 
+	//! Thread-safe pool of MongoDB clients.
+	/*!
+	A single Connection is not thread-safe, so each worker thread checks out its own
+	connection from a pool. A checked out connection exposes the usual Collection API
+	and returns its client to the pool when destroyed. Connections and collections
+	should be destroyed before the pool.
+	*/
+	class ConnectionPool {
+	friend class Connection;
+	public:
+
+		//! Pool usage statistics.
+		struct Stats {
+			uint64_t			acquired;			//!< Total number of checked out connections.
+			uint64_t			waited;				//!< Number of checkouts that waited for a free client.
+			uint64_t			totalWaitUs;		//!< Total time spent waiting for a free client in microseconds.
+			uint64_t			maxWaitUs;			//!< The longest wait for a free client in microseconds.
+			uint32_t			inUse;				//!< Number of connections currently checked out.
+		};
+
+								//! Constructs ConnectionPool instance and warms up minSize connections.
+								ConnectionPool( const std::string& uri, const std::string& db, uint32_t minSize = 0, uint32_t maxSize = 100 );
+								~ConnectionPool( void );
+
+		//! Checks out a connection, blocks while all clients are in use.
+		ConnectionPtr			acquire( void );
+
+		//! Checks out a connection without blocking, returns NULL if all clients are in use.
+		ConnectionPtr			tryAcquire( void );
+
+		//! Opens connections up to the minimum pool size by pinging a server.
+		bool					warmUp( void );
+
+		//! Returns pool usage statistics.
+		Stats					stats( void ) const;
+
+	private:
+
+								//! Pools are not copyable.
+								ConnectionPool( const ConnectionPool& );
+		ConnectionPool&			operator = ( const ConnectionPool& );
+
+		//! Returns a client to the pool.
+		void					release( mongoc_client_t* client );
+
+	private:
+
+		//! Actual client pool.
+		mongoc_client_pool_t*	m_pool;
+
+		//! Database name.
+		std::string				m_db;
+
+		//! Minimum number of warmed up clients.
+		uint32_t				m_minSize;
+
+		//! Maximum number of clients.
+		uint32_t				m_maxSize;
+
+		std::atomic<uint64_t>	m_acquired;		//!< Total number of checkouts.
+		std::atomic<uint64_t>	m_waited;		//!< Number of checkouts that waited.
+		std::atomic<uint64_t>	m_totalWaitUs;	//!< Total wait time.
+		std::atomic<uint64_t>	m_maxWaitUs;	//!< The longest wait time.
+		std::atomic<uint32_t>	m_inUse;		//!< Number of checked out connections.
+	};
+
     // ** class Document
     class Document {
     friend class Cursor;
+    friend class DocumentView;
+    friend class PrefetchCursor;
     public:
 
                                 ~Document( void );
@@ -180,12 +633,46 @@ namespace mongo {
         std::string             string( const char* key ) const;
         double                  number( const char* key ) const;
         int                     integer( const char* key ) const;
-        DocumentPtr             array( const char* key ) const;
-		DocumentPtr				object( const char* key ) const;
+		int64_t					int64( const char* key ) const;
+		DateTime				dateTime( const char* key ) const;
+		Binary					binary( const char* key ) const;
+		Decimal128				decimal( const char* key ) const;
+		//! Returns a borrowed view of a nested array, valid while this document is alive.
+        DocumentView            array( const char* key ) const;
+
+		//! Returns a borrowed view of a nested document, valid while this document is alive.
+		DocumentView			object( const char* key ) const;
         StringSet               keys( void ) const;
         IntegerSet              integerSet( const char* key ) const;
         FloatArray              numbers( const char* key ) const;
 		StringArray				strings( const char* key ) const;
+		IntegerArray			integers( const char* key ) const;
+		DoubleArray				doubles( const char* key ) const;
+
+		//! Returns the number of array elements.
+		uint32_t				arraySize( const char* key ) const;
+
+		//! Decodes numeric array elements into a caller-provided buffer.
+		/*!
+		Double, int32 and int64 elements are converted to a buffer type, other elements are decoded as zero.
+		\param key Array key.
+		\param values Output buffer.
+		\param capacity Maximum number of values to write.
+		\return The number of written values.
+		*/
+		uint32_t				numbers( const char* key, double* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, float* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, int32_t* values, uint32_t capacity ) const;
+		uint32_t				numbers( const char* key, int64_t* values, uint32_t capacity ) const;
+
+		//! Returns a view of this document.
+		DocumentView			view( void ) const;
+
+		//! Enables the lazy field index, so repeated lookups of the same keys don't rescan a document.
+		/*!
+		Must be called before a document is shared with other threads, lookups themselves are thread-safe.
+		*/
+		void					enableIndex( void );
 
     private:
 
@@ -194,9 +681,22 @@ namespace mongo {
     private:
 
         bson_t*                 m_document;
+
+		//! Optional field index.
+		std::unique_ptr<FieldIndex>	m_index;
     };
 
 }
 
 
+namespace std {
+
+	//! Hash function for mongo::OID, so ObjectIds can be used as unordered container keys.
+	template<>
+	struct hash<mongo::OID> {
+		size_t operator()( const mongo::OID& oid ) const { return oid.hash(); }
+	};
+
+} // namespace std
+
 #endif /*	!__Mongocpp_Mongo_H__	*/
@@ -28,18 +28,148 @@
 
 #include "MongoBson.h"
 
+#include <algorithm>
+
 namespace mongo {
 
-// ** BSON::BSON
-BSON::BSON( void ) : m_bson( bson_new() )
+// ------------------------------------------ BsonArena ---------------------------------------- //
+
+//! Arena that is active on the current thread.
+static thread_local BsonArena* s_currentArena = NULL;
+
+//! Allocator that places shared pointer control blocks inside an arena.
+template<typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+
+							ArenaAllocator( BsonArena* arena ) : m_arena( arena ) {}
+	template<typename U>	ArenaAllocator( const ArenaAllocator<U>& other ) : m_arena( other.m_arena ) {}
+
+	T*						allocate( size_t count ) { return static_cast<T*>( m_arena->allocate( count * sizeof( T ), alignof( T ) ) ); }
+	void					deallocate( T*, size_t ) {}
+
+	BsonArena*				m_arena;
+};
+
+template<typename T, typename U>
+bool operator == ( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) { return a.m_arena == b.m_arena; }
+
+template<typename T, typename U>
+bool operator != ( const ArenaAllocator<T>& a, const ArenaAllocator<U>& b ) { return a.m_arena != b.m_arena; }
+
+// ** BsonArena::BsonArena
+BsonArena::BsonArena( size_t blockSize ) : m_offset( 0 ), m_blockSize( blockSize )
+{
+
+}
+
+BsonArena::~BsonArena( void )
 {
-	bson_init( raw() );
+	assert( s_currentArena != this );
+
+	for( size_t i = 0; i < m_blocks.size(); i++ ) {
+		delete[]m_blocks[i].data;
+	}
+}
+
+// ** BsonArena::allocate
+void* BsonArena::allocate( size_t size, size_t alignment )
+{
+	size_t padding = 0;
+
+	if( !m_blocks.empty() ) {
+		padding = ( alignment - reinterpret_cast<uintptr_t>( m_blocks.back().data + m_offset ) % alignment ) % alignment;
+	}
+
+	if( m_blocks.empty() || m_offset + padding + size > m_blocks.back().capacity ) {
+		Block block;
+		block.capacity = std::max( m_blockSize, size + alignment );
+		block.data	   = new char[block.capacity];
+		m_blocks.push_back( block );
+
+		m_offset = 0;
+		padding  = ( alignment - reinterpret_cast<uintptr_t>( block.data ) % alignment ) % alignment;
+	}
+
+	char* result = m_blocks.back().data + m_offset + padding;
+	m_offset += padding + size;
+
+	return result;
+}
+
+// ** BsonArena::reset
+void BsonArena::reset( void )
+{
+	for( size_t i = 1; i < m_blocks.size(); i++ ) {
+		delete[]m_blocks[i].data;
+	}
+
+	if( m_blocks.size() > 1 ) {
+		m_blocks.resize( 1 );
+	}
+
+	m_offset = 0;
+}
+
+// ** BsonArena::current
+BsonArena* BsonArena::current( void )
+{
+	return s_currentArena;
+}
+
+// ** BsonArena::Scope::Scope
+BsonArena::Scope::Scope( BsonArena& arena ) : m_previous( s_currentArena )
+{
+	s_currentArena = &arena;
+}
+
+BsonArena::Scope::~Scope( void )
+{
+	s_currentArena = m_previous;
+}
+
+// ------------------------------------------ BSON ---------------------------------------- //
+
+//! Destroys a BSON object owned by a BSON wrapper.
+static void destroyBson( bson_t* bson )
+{
+	if( bson == NULL ) {
+		return;
+	}
+
+	// bson_destroy doesn't release the structure of a static document.
+	bool isStatic = ( bson->flags & BSON_FLAG_STATIC ) != 0;
+
+	bson_destroy( bson );
+
+	if( isStatic ) {
+		bson_free( bson );
+	}
 }
 
 // ** BSON::BSON
-BSON::BSON( bson_t* value ) : m_bson( value )
+BSON::BSON( void )
 {
+	BsonArena* arena = BsonArena::current();
+
+	if( arena == NULL ) {
+		m_bson = BsonPtr( bson_new(), destroyBson );
+		return;
+	}
 
+	// The document is initialized in place with an inline storage, the arena owns the structure memory.
+	bson_t* bson = static_cast<bson_t*>( arena->allocate( sizeof( bson_t ), alignof( bson_t ) ) );
+	bson_init( bson );
+	m_bson = BsonPtr( bson, bson_destroy, ArenaAllocator<bson_t>( arena ) );
+}
+
+// ** BSON::BSON
+BSON::BSON( bson_t* value )
+{
+	// A null BSON doesn't need a reference counter.
+	if( value ) {
+		m_bson = BsonPtr( value, destroyBson );
+	}
 }
 
 // ** BSON::object
@@ -60,6 +190,44 @@ void BSON::set( const char* key, int value )
 	bson_append_int32( raw(), key, strlen( key ), value );
 }
 
+// ** BSON::set
+void BSON::set( const char* key, long value )
+{
+	bson_append_int64( raw(), key, strlen( key ), value );
+}
+
+// ** BSON::set
+void BSON::set( const char* key, long long value )
+{
+	bson_append_int64( raw(), key, strlen( key ), value );
+}
+
+// ** BSON::set
+void BSON::set( const char* key, unsigned int value )
+{
+	if( value <= INT32_MAX ) {
+		bson_append_int32( raw(), key, strlen( key ), ( int32_t )value );
+	} else {
+		bson_append_int64( raw(), key, strlen( key ), ( int64_t )value );
+	}
+}
+
+// ** BSON::set
+void BSON::set( const char* key, unsigned long value )
+{
+	set( key, ( unsigned long long )value );
+}
+
+// ** BSON::set
+void BSON::set( const char* key, unsigned long long value )
+{
+	if( value <= INT64_MAX ) {
+		bson_append_int64( raw(), key, strlen( key ), ( int64_t )value );
+	} else {
+		bson_append_double( raw(), key, strlen( key ), ( double )value );
+	}
+}
+
 // ** BSON::set
 void BSON::set( const char* key, double value )
 {
@@ -84,6 +252,28 @@ void BSON::set( const char* key, const OID& value )
 	bson_append_oid( raw(), key, strlen( key ), value.raw() );
 }
 
+// ** BSON::set
+void BSON::set( const char* key, const DateTime& value )
+{
+	bson_append_date_time( raw(), key, strlen( key ), value.milliseconds );
+}
+
+// ** BSON::set
+void BSON::set( const char* key, const Binary& value )
+{
+	bson_append_binary( raw(), key, strlen( key ), ( bson_subtype_t )value.subtype, value.data, value.length );
+}
+
+// ** BSON::set
+void BSON::set( const char* key, const Decimal128& value )
+{
+	bson_decimal128_t decimal;
+	decimal.high = value.high;
+	decimal.low  = value.low;
+
+	bson_append_decimal128( raw(), key, strlen( key ), &decimal );
+}
+
 // ** BSON::setNull
 void BSON::setNull( const char* key )
 {
@@ -115,29 +305,33 @@ bson_t* BSON::raw( void ) const
 }
 
 // ** BSON::iter
-IterPtr BSON::iter( void ) const
+Iter BSON::iter( void ) const
 {
-	IterPtr result( new Iter( m_bson.get() ) );
+	return Iter( raw() );
+}
 
-	if( !result->raw() ) {
-		return IterPtr();
-	}
+// ** BSON::begin
+Iter BSON::begin( void ) const
+{
+	return Iter( raw() );
+}
 
-	return result;
+// ** BSON::end
+Iter BSON::end( void ) const
+{
+	return Iter();
 }
 
 // ** BSON::find
-IterPtr BSON::find( const char* key )
+Iter BSON::find( const char* key ) const
 {
-	bson_iter_t  iter;
-	bson_iter_t* field = new bson_iter_t;
+	bson_iter_t iter, field;
 
-	if( bson_iter_init( &iter, raw() ) && bson_iter_find_descendant( &iter, key, field ) ) {
-		return IterPtr( new Iter( field ) );
+	if( raw() && bson_iter_init( &iter, raw() ) && bson_iter_find_descendant( &iter, key, &field ) ) {
+		return Iter( &field );
     }
 
-	delete field;
-	return IterPtr();
+	return Iter();
 }
 
 // -------------------------------------- DocumentSelector ------------------------------------- //
@@ -162,6 +356,106 @@ DocumentSelector& DocumentSelector::operator << ( bool value )
 	return *this;
 }
 
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( int value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( long value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( long long value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( unsigned int value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( unsigned long value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( unsigned long long value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( double value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( const DateTime& value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( const Binary& value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
+// ** DocumentSelector::operator <<
+DocumentSelector& DocumentSelector::operator << ( const Decimal128& value )
+{
+	assert( m_key != "" );
+	set( m_key.c_str(), value );
+	m_key = "";
+
+	return *this;
+}
+
 // ** DocumentSelector::operator <<
 DocumentSelector& DocumentSelector::operator << ( const char* value )
 {
@@ -194,8 +488,8 @@ DocumentSelector& DocumentSelector::operator << ( const BSON* value )
 // ** DocumentSelector::operator <<
 DocumentSelector& DocumentSelector::operator << ( const DocumentSelector& value )
 {
-	assert( m_key.c_str() != "" );
-	setDocument( m_key.c_str(), BSON( value.copy() ) );
+	assert( m_key != "" );
+	setDocument( m_key.c_str(), value );
 	m_key = "";
 
 	return *this;
@@ -204,8 +498,8 @@ DocumentSelector& DocumentSelector::operator << ( const DocumentSelector& value
 // ** DocumentSelector::operator <<
 DocumentSelector& DocumentSelector::operator << ( const ArraySelector& value )
 {
-	assert( m_key.c_str() != "" );
-	setArray( m_key.c_str(), BSON( value.copy() ) );
+	assert( m_key != "" );
+	setArray( m_key.c_str(), value );
 	m_key = "";
 
 	return *this;
@@ -239,14 +533,91 @@ ArraySelector::ArraySelector( void ) : m_index( 0 )
 // ** ArraySelector::operator <<
 ArraySelector& ArraySelector::operator << ( const OID& value )
 {
-	set( key().c_str(), value );
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( bool value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( int value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( long value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( long long value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( unsigned int value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( unsigned long value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( unsigned long long value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( double value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( const DateTime& value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( const Binary& value )
+{
+	set( key(), value );
+	return *this;
+}
+
+// ** ArraySelector::operator <<
+ArraySelector& ArraySelector::operator << ( const Decimal128& value )
+{
+	set( key(), value );
 	return *this;
 }
 
 // ** ArraySelector::operator <<
 ArraySelector& ArraySelector::operator << ( const char* value )
 {
-	set( key().c_str(), value );
+	set( key(), value );
 	return *this;
 }
 
@@ -259,59 +630,345 @@ ArraySelector& ArraySelector::operator << ( const std::string& value )
 // ** ArraySelector::operator <<
 ArraySelector& ArraySelector::operator << ( const DocumentSelector& value )
 {
-	setDocument( key().c_str(), BSON( value.copy() ) );
+	setDocument( key(), value );
 	return *this;
 }
 
 // ** ArraySelector::operator <<
 ArraySelector& ArraySelector::operator << ( const ArraySelector& value )
 {
-	setArray( key().c_str(), BSON( value.copy() ) );
+	setArray( key(), value );
 	return *this;
 }
 
 // ** ArraySelector::key
-std::string ArraySelector::key( void )
+const char* ArraySelector::key( void )
 {
-	char buffer[16];
-#ifdef WIN32
-	sprintf_s( buffer, 16, "%d", m_index++ );
-#else
-	sprintf( buffer, "%d", m_index++ );
-#endif
-	return buffer;
+	// Small indices are served from a static table of libbson, larger ones are formatted to an inline buffer.
+	const char* key;
+	bson_uint32_to_string( ( uint32_t )m_index++, &key, m_key, sizeof( m_key ) );
+	return key;
 }
 
-// ---------------------------------------- Iter --------------------------------------- //
+// -------------------------------------- PreparedSelector ------------------------------------- //
 
-// ** Iter::Iter
-Iter::Iter( const bson_t* bson )
+//! Writes a little-endian integer value to a buffer.
+static inline void writeUInt32( uint8_t* data, uint32_t value ) { value = BSON_UINT32_TO_LE( value ); memcpy( data, &value, 4 ); }
+static inline void writeUInt64( uint8_t* data, uint64_t value ) { value = BSON_UINT64_TO_LE( value ); memcpy( data, &value, 8 ); }
+
+//! Copies document fields replacing a string value at a specified address.
+static void copyReplacing( bson_iter_t* iter, bson_t* target, const uint8_t* replaced, const char* value, uint32_t length )
+{
+	while( bson_iter_next( iter ) ) {
+		const char*    key       = bson_iter_key( iter );
+		uint32_t       keyLength = ( uint32_t )strlen( key );
+		const uint8_t* field     = reinterpret_cast<const uint8_t*>( key ) + keyLength + 1;
+
+		if( field == replaced ) {
+			bson_append_utf8( target, key, keyLength, value, length );
+			continue;
+		}
+
+		bson_type_t type = bson_iter_type( iter );
+
+		if( type != BSON_TYPE_DOCUMENT && type != BSON_TYPE_ARRAY ) {
+			bson_append_iter( target, key, keyLength, iter );
+			continue;
+		}
+
+		// Only the nested document that holds the replaced value is rebuilt, others are copied as is.
+		const uint8_t* data;
+		uint32_t       size;
+
+		if( type == BSON_TYPE_DOCUMENT ) {
+			bson_iter_document( iter, &size, &data );
+		} else {
+			bson_iter_array( iter, &size, &data );
+		}
+
+		if( replaced < data || replaced >= data + size ) {
+			bson_append_iter( target, key, keyLength, iter );
+			continue;
+		}
+
+		bson_t      child;
+		bson_iter_t children;
+
+		if( type == BSON_TYPE_DOCUMENT ) {
+			bson_append_document_begin( target, key, keyLength, &child );
+		} else {
+			bson_append_array_begin( target, key, keyLength, &child );
+		}
+
+		bson_iter_recurse( iter, &children );
+		copyReplacing( &children, &child, replaced, value, length );
+
+		if( type == BSON_TYPE_DOCUMENT ) {
+			bson_append_document_end( target, &child );
+		} else {
+			bson_append_array_end( target, &child );
+		}
+	}
+}
+
+// ** PreparedSelector::PreparedSelector
+PreparedSelector::PreparedSelector( const BSON& shape ) : BSON( shape.copy() )
+{
+
+}
+
+// ** PreparedSelector::resolve
+bool PreparedSelector::resolve( const char* path, uint32_t& offset, int& type ) const
+{
+	bson_iter_t iter, field;
+
+	if( !bson_iter_init( &iter, raw() ) || !bson_iter_find_descendant( &iter, path, &field ) ) {
+		return false;
+	}
+
+	// Keys point into the document buffer and a value follows the zero-terminated key.
+	const char* key = bson_iter_key( &field );
+	offset = ( uint32_t )( reinterpret_cast<const uint8_t*>( key ) + strlen( key ) + 1 - bson_get_data( raw() ) );
+	type   = bson_iter_type( &field );
+
+	return true;
+}
+
+// ** PreparedSelector::slot
+int PreparedSelector::slot( const char* path )
+{
+	Slot slot;
+	slot.path = path;
+
+	if( !resolve( path, slot.offset, slot.type ) ) {
+		return -1;
+	}
+
+	m_slots.push_back( slot );
+	return ( int )m_slots.size() - 1;
+}
+
+// ** PreparedSelector::value
+uint8_t* PreparedSelector::value( int slot, int type ) const
+{
+	if( slot < 0 || slot >= ( int )m_slots.size() ) {
+		printf( "PreparedSelector::bind : invalid slot %d\n", slot );
+		return NULL;
+	}
+
+	// A mismatched value is rejected before anything is written, so the document stays unchanged.
+	if( m_slots[slot].type != type ) {
+		printf( "PreparedSelector::bind : slot '%s' holds BSON type 0x%02x, can't bind a value of type 0x%02x\n", m_slots[slot].path.c_str(), m_slots[slot].type, type );
+		return NULL;
+	}
+
+	// The document is owned by this selector, so its buffer is patched directly.
+	return const_cast<uint8_t*>( bson_get_data( raw() ) ) + m_slots[slot].offset;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, bool value )
+{
+	uint8_t* data = this->value( slot, BSON_TYPE_BOOL );
+
+	if( data ) {
+		*data = value ? 1 : 0;
+	}
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, int value )
+{
+	uint8_t* data = this->value( slot, BSON_TYPE_INT32 );
+
+	if( data ) {
+		writeUInt32( data, ( uint32_t )value );
+	}
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, int64_t value )
+{
+	uint8_t* data = this->value( slot, BSON_TYPE_INT64 );
+
+	if( data ) {
+		writeUInt64( data, ( uint64_t )value );
+	}
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, double value )
 {
-	m_iter = BsonIteratorPtr( new bson_iter_t );
-	
-	if( !bson_iter_init( raw(), bson ) ) {
-		m_iter = BsonIteratorPtr();
+	uint8_t* data = this->value( slot, BSON_TYPE_DOUBLE );
+
+	if( data ) {
+		uint64_t bits;
+		memcpy( &bits, &value, 8 );
+		writeUInt64( data, bits );
 	}
-	else if( !bson_iter_next( raw() ) ) {
-		m_iter = BsonIteratorPtr();
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, const OID& value )
+{
+	uint8_t* data = this->value( slot, BSON_TYPE_OID );
+
+	if( data ) {
+		memcpy( data, value.bytes(), 12 );
+	}
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, const DateTime& value )
+{
+	uint8_t* data = this->value( slot, BSON_TYPE_DATE_TIME );
+
+	if( data ) {
+		writeUInt64( data, ( uint64_t )value.milliseconds );
 	}
+
+	return data != NULL;
+}
+
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, const std::string& value )
+{
+	return bind( slot, value.c_str() );
 }
 
+// ** PreparedSelector::bind
+bool PreparedSelector::bind( int slot, const char* value )
+{
+	uint8_t* data = value ? this->value( slot, BSON_TYPE_UTF8 ) : NULL;
+
+	if( !data ) {
+		return false;
+	}
+
+	// A string is stored as a length that includes the zero terminator followed by the bytes.
+	uint32_t current;
+	memcpy( &current, data, 4 );
+	current = BSON_UINT32_FROM_LE( current );
+
+	uint32_t length = ( uint32_t )strlen( value );
+
+	if( length + 1 == current ) {
+		memcpy( data + 4, value, length );
+	} else {
+		relayout( slot, value, length );
+	}
+
+	return true;
+}
+
+// ** PreparedSelector::relayout
+void PreparedSelector::relayout( int slot, const char* value, uint32_t length )
+{
+	bson_t*     document = bson_sized_new( raw()->len + length );
+	bson_iter_t iter;
+
+	bson_iter_init( &iter, raw() );
+	copyReplacing( &iter, document, bson_get_data( raw() ) + m_slots[slot].offset, value, length );
+
+	static_cast<BSON&>( *this ) = BSON( document );
+
+	// Values after the replaced string have moved, so all slots are resolved again.
+	for( size_t i = 0; i < m_slots.size(); i++ ) {
+		bool resolved = resolve( m_slots[i].path.c_str(), m_slots[i].offset, m_slots[i].type );
+		assert( resolved );
+		( void )resolved;
+	}
+}
+
+// ---------------------------------------- Iter --------------------------------------- //
+
 // ** Iter::Iter
-Iter::Iter( bson_iter_t* iter )
+Iter::Iter( void ) : m_isValid( false )
 {
-	m_iter = BsonIteratorPtr( iter );
+	static_assert( sizeof( bson_iter_t ) <= sizeof( m_iter ), "Iter storage is too small for bson_iter_t" );
+	static_assert( alignof( bson_iter_t ) <= 128, "Iter storage is not aligned enough for bson_iter_t" );
+}
+
+// ** Iter::Iter
+Iter::Iter( const bson_t* bson ) : m_isValid( false )
+{
+	m_isValid = bson && bson_iter_init( raw(), bson ) && bson_iter_next( raw() );
+}
+
+// ** Iter::Iter
+Iter::Iter( const uint8_t* data, uint32_t length ) : m_isValid( false )
+{
+	m_isValid = data && bson_iter_init_from_data( raw(), data, length ) && bson_iter_next( raw() );
+}
+
+// ** Iter::Iter
+Iter::Iter( const bson_iter_t* iter ) : m_isValid( iter != NULL )
+{
+	if( iter ) {
+		memcpy( m_iter, iter, sizeof( bson_iter_t ) );
+	}
 }
 
 // ** Iter::raw
 bson_iter_t* Iter::raw( void ) const
 {
-	return m_iter.get();
+	return reinterpret_cast<bson_iter_t*>( const_cast<uint8_t*>( m_iter ) );
+}
+
+// ** Iter::isValid
+bool Iter::isValid( void ) const
+{
+	return m_isValid;
+}
+
+// ** Iter::recurse
+Iter Iter::recurse( void ) const
+{
+	Iter result;
+
+	if( m_isValid ) {
+		result.m_isValid = bson_iter_recurse( raw(), result.raw() ) && bson_iter_next( result.raw() );
+	}
+
+	return result;
+}
+
+// ** Iter::operator *
+const Iter& Iter::operator * ( void ) const
+{
+	return *this;
+}
+
+// ** Iter::operator ++
+Iter& Iter::operator ++ ( void )
+{
+	next();
+	return *this;
+}
+
+// ** Iter::operator !=
+bool Iter::operator != ( const Iter& other ) const
+{
+	return m_isValid != other.m_isValid;
 }
 
 // ** Iter::type
 ValueType Iter::type( void ) const
 {
+	if( !m_isValid ) {
+		return BsonNull;
+	}
+
 	switch( bson_iter_type( raw() ) ) {
 	case BSON_TYPE_BOOL:		return BsonBoolean;
 	case BSON_TYPE_INT32:		return BsonInt32;
@@ -320,6 +977,11 @@ ValueType Iter::type( void ) const
 	case BSON_TYPE_UTF8:		return BsonString;
 	case BSON_TYPE_ARRAY:		return BsonArray;
 	case BSON_TYPE_DOCUMENT:	return BsonObject;
+	case BSON_TYPE_INT64:		return BsonInt64;
+	case BSON_TYPE_DATE_TIME:	return BsonDateTime;
+	case BSON_TYPE_BINARY:		return BsonBinary;
+	case BSON_TYPE_DECIMAL128:	return BsonDecimal128;
+	default:					break;
 	}
 
 	return BsonNull;
@@ -328,19 +990,20 @@ ValueType Iter::type( void ) const
 // ** Iter::key
 const char* Iter::key( void ) const
 {
-	return bson_iter_key( raw() );
+	return m_isValid ? bson_iter_key( raw() ) : "";
 }
 
 // ** Iter::next
 bool Iter::next( void )
 {
-	return bson_iter_next( raw() );
+	m_isValid = m_isValid && bson_iter_next( raw() );
+	return m_isValid;
 }
 
 // ** Iter::toBool
 bool Iter::toBool( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_BOOL ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_BOOL ) {
 		return bson_iter_bool( raw() );
 	}
 
@@ -350,17 +1013,69 @@ bool Iter::toBool( void ) const
 // ** Iter::toInt
 int Iter::toInt( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_INT32 ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_INT32 ) {
+		return bson_iter_int32( raw() );
+	}
+
+	return 0;
+}
+
+// ** Iter::toInt64
+int64_t Iter::toInt64( void ) const
+{
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_INT64 ) {
+		return bson_iter_int64( raw() );
+	}
+
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_INT32 ) {
 		return bson_iter_int32( raw() );
 	}
 
 	return 0;
 }
 
+// ** Iter::toDateTime
+DateTime Iter::toDateTime( void ) const
+{
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_DATE_TIME ) {
+		return DateTime( bson_iter_date_time( raw() ) );
+	}
+
+	return DateTime();
+}
+
+// ** Iter::toBinary
+Binary Iter::toBinary( void ) const
+{
+	Binary result;
+
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_BINARY ) {
+		bson_subtype_t subtype;
+		bson_iter_binary( raw(), &subtype, &result.length, &result.data );
+		result.subtype = ( uint8_t )subtype;
+	}
+
+	return result;
+}
+
+// ** Iter::toDecimal128
+Decimal128 Iter::toDecimal128( void ) const
+{
+	bson_decimal128_t decimal;
+	Decimal128		  result;
+
+	if( m_isValid && bson_iter_decimal128( raw(), &decimal ) ) {
+		result.high = decimal.high;
+		result.low  = decimal.low;
+	}
+
+	return result;
+}
+
 // ** Iter::toDouble
 double Iter::toDouble( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_DOUBLE ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_DOUBLE ) {
 		return bson_iter_double( raw() );
 	}
 
@@ -370,11 +1085,11 @@ double Iter::toDouble( void ) const
 // ** Iter::toObjectId
 OID Iter::toObjectId( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_OID ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_OID ) {
 		return OID( *bson_iter_oid( raw() ) );
 	}
 
-	return OID( "000000000000000000000000" );
+	return OID();
 }
 
 
@@ -383,7 +1098,7 @@ const char* Iter::toString( void ) const
 {
 	uint32_t length = 0;
 
-	if( bson_iter_type( raw() ) == BSON_TYPE_UTF8 ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_UTF8 ) {
 		return bson_iter_utf8( raw(), &length );
 	}
 
@@ -391,37 +1106,31 @@ const char* Iter::toString( void ) const
 }
 
 // ** Iter::toArray
-BSON Iter::toArray( void ) const
+DocumentView Iter::toArray( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_ARRAY ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_ARRAY ) {
 		const uint8_t* data;
         uint32_t       length;
         bson_iter_array( raw(), &length, &data );
-		
-		bson_t* array = bson_new();
-        bson_init_static( array, data, length );
 
-		return BSON( array );
+		return DocumentView( data, length );
 	}
 
-	return BSON( ( bson_t* )NULL );
+	return DocumentView();
 }
 
 // ** Iter::toObject
-BSON Iter::toObject( void ) const
+DocumentView Iter::toObject( void ) const
 {
-	if( bson_iter_type( raw() ) == BSON_TYPE_DOCUMENT ) {
+	if( m_isValid && bson_iter_type( raw() ) == BSON_TYPE_DOCUMENT ) {
 		const uint8_t* data;
         uint32_t       length;
         bson_iter_document( raw(), &length, &data );
-		
-		bson_t* document = bson_new();
-        bson_init_static( document, data, length );
 
-		return BSON( document );
+		return DocumentView( data, length );
 	}
 
-	return BSON( ( bson_t* )NULL );
+	return DocumentView();
 }
 
 } // namespace mongo
@@ -43,24 +43,45 @@ namespace mongo {
 		BsonObjectId,
 		BsonObject,
 		BsonArray,
+		BsonInt64,
+		BsonDateTime,
+		BsonBinary,
+		BsonDecimal128,
 	};
 
 	//! BSON object iterator.
+	/*!
+	Iter is a value type that keeps the BSON iterator inline, so walking a document
+	and recursing into nested documents doesn't allocate. Iter also serves as an input
+	iterator for range-based for loops over BSON objects.
+	*/
 	class Iter {
 	public:
 
-								//! Constructs Iter instance.
+								//! Constructs an invalid iterator, used as an end iterator.
+								Iter( void );
+
+								//! Constructs Iter instance positioned at the first field of a document.
 								Iter( const bson_t* bson );
 
+								//! Constructs Iter instance positioned at the first field of a raw BSON buffer.
+								Iter( const uint8_t* data, uint32_t length );
+
 								//! Constructs Iter instance from BSON iterator.
-								Iter( bson_iter_t* iter );
+								Iter( const bson_iter_t* iter );
 
 		//! Switches to a next value.
 		bool					next( void );
 
+		//! Returns true if an iterator points to a field.
+		bool					isValid( void ) const;
+
 		//! Returns raw iterator pointer.
 		bson_iter_t*			raw( void ) const;
 
+		//! Returns an iterator positioned at the first field of a nested document or array.
+		Iter					recurse( void ) const;
+
 		//! Returns iterator value type.
 		ValueType				type( void ) const;
 
@@ -76,39 +97,127 @@ namespace mongo {
 		//! Returns integer iterator value.
 		int						toInt( void ) const;
 
+		//! Returns 64-bit integer iterator value, 32-bit integers are widened.
+		int64_t					toInt64( void ) const;
+
 		//! Returns double iterator value.
 		double					toDouble( void ) const;
 
+		//! Returns UTC datetime iterator value.
+		DateTime				toDateTime( void ) const;
+
+		//! Returns binary iterator value, the payload points into the document buffer.
+		Binary					toBinary( void ) const;
+
+		//! Returns decimal iterator value.
+		Decimal128				toDecimal128( void ) const;
+
 		//! Returns ObjectId iterator value.
 		OID						toObjectId( void ) const;
 
-		//! Returns array iterator value.
-		BSON					toArray( void ) const;
+		//! Returns a borrowed view of an array value, valid while the parent document is alive.
+		DocumentView			toArray( void ) const;
 
-		//! Returns object iterator value.
-		BSON					toObject( void ) const;
+		//! Returns a borrowed view of an object value, valid while the parent document is alive.
+		DocumentView			toObject( void ) const;
+
+		//! Returns the current field, used by range-based for loops.
+		const Iter&				operator * ( void ) const;
+
+		//! Switches to a next field, used by range-based for loops.
+		Iter&					operator ++ ( void );
+
+		//! Compares iterators by their validity, so any valid iterator differs from the end one.
+		bool					operator != ( const Iter& other ) const;
 
 	private:
 
-		//! BSON iterator pointer type.
-		typedef std::shared_ptr<bson_iter_t> BsonIteratorPtr;
+		//! Inline storage for a bson_iter_t, the size is checked when the library is compiled.
+		alignas( 128 ) uint8_t	m_iter[128];
 
-		//! Bson object iterator.
-		BsonIteratorPtr			m_iter;
+		//! Flag indicating that an iterator points to a field.
+		bool					m_isValid;
 	};
 
-	//! BSON iterator pointer type.
-	typedef std::shared_ptr<Iter> IterPtr;
+	//! Memory arena used to build BSON selectors without heap allocations.
+	/*!
+	While an arena is active on a thread all BSON objects created by this thread
+	place their document and reference counter inside the arena blocks, so a whole
+	selector tree built with DOCUMENT and ARRAY macros ends up in a few contiguous
+	buffers. Documents that outgrow the inline BSON storage still grow on the heap.
+	BSON objects created inside an arena must be destroyed before the arena is reset.
+	*/
+	class BsonArena {
+	public:
+
+		//! Makes an arena active on the current thread until the scope is destroyed.
+		class Scope {
+		public:
+
+								//! Constructs Scope instance and activates the arena.
+								Scope( BsonArena& arena );
+
+								//! Restores the previously active arena.
+								~Scope( void );
+
+		private:
+
+			//! Previously active arena.
+			BsonArena*			m_previous;
+		};
+
+							//! Constructs BsonArena instance.
+							BsonArena( size_t blockSize = 4096 );
+							~BsonArena( void );
+
+		//! Allocates a memory block with a specified alignment.
+		void*				allocate( size_t size, size_t alignment );
+
+		//! Releases all allocations, the first block is kept for reuse.
+		void				reset( void );
+
+		//! Returns the arena active on the current thread.
+		static BsonArena*	current( void );
+
+	private:
+
+							//! Arenas are not copyable.
+							BsonArena( const BsonArena& );
+		BsonArena&			operator = ( const BsonArena& );
+
+	private:
+
+		//! Arena memory block.
+		struct Block {
+			char*			data;		//!< Block memory.
+			size_t			capacity;	//!< Block size in bytes.
+		};
+
+		//! Allocated memory blocks.
+		std::vector<Block>	m_blocks;
+
+		//! Allocation offset inside the last block.
+		size_t				m_offset;
+
+		//! Default size of a memory block.
+		size_t				m_blockSize;
+	};
 
 	//! The BSON object wrapper.
     class BSON {
     public:
 
-		//! Returns an iterator.
-		IterPtr					iter( void ) const;
+		//! Returns an iterator positioned at the first field.
+		Iter					iter( void ) const;
+
+		//! Finds a field with a specified key, returns an invalid iterator if there is no such field.
+		Iter					find( const char* key ) const;
 
-		//! Finds a field with a specified key.
-		IterPtr					find( const char* key );
+		//! Returns an iterator to the first field, used by range-based for loops.
+		Iter					begin( void ) const;
+
+		//! Returns an end iterator.
+		Iter					end( void ) const;
 
 		//! Return the raw BSON pointer.
 		bson_t*					raw( void ) const;
@@ -122,6 +231,15 @@ namespace mongo {
 		//! Appends integer value to BSON.
 		void					set( const char* key, int value );
 
+		//! Appends 64-bit integer value to BSON.
+		void					set( const char* key, long value );
+		void					set( const char* key, long long value );
+
+		//! Appends unsigned integer value to BSON as the narrowest signed type that holds it, values above the int64 range become doubles.
+		void					set( const char* key, unsigned int value );
+		void					set( const char* key, unsigned long value );
+		void					set( const char* key, unsigned long long value );
+
 		//! Appends double value to BSON.
 		void					set( const char* key, double value );
 
@@ -132,6 +250,15 @@ namespace mongo {
 		//! Appends ObjectId value to BSON.
 		void					set( const char* key, const OID& value );
 
+		//! Appends UTC datetime value to BSON.
+		void					set( const char* key, const DateTime& value );
+
+		//! Appends binary value to BSON.
+		void					set( const char* key, const Binary& value );
+
+		//! Appends decimal value to BSON.
+		void					set( const char* key, const Decimal128& value );
+
 		//! Appends null to BSON.
 		void					setNull( const char* key );
 
@@ -171,6 +298,24 @@ namespace mongo {
 		//! Appends boolean value to selector.
 		DocumentSelector&			operator << ( bool value );
 
+		//! Appends numeric value to selector.
+		DocumentSelector&			operator << ( int value );
+		DocumentSelector&			operator << ( long value );
+		DocumentSelector&			operator << ( long long value );
+		DocumentSelector&			operator << ( unsigned int value );
+		DocumentSelector&			operator << ( unsigned long value );
+		DocumentSelector&			operator << ( unsigned long long value );
+		DocumentSelector&			operator << ( double value );
+
+		//! Appends UTC datetime value to selector.
+		DocumentSelector&			operator << ( const DateTime& value );
+
+		//! Appends binary value to selector.
+		DocumentSelector&			operator << ( const Binary& value );
+
+		//! Appends decimal value to selector.
+		DocumentSelector&			operator << ( const Decimal128& value );
+
 		//! Appends ObjectId value to selector.
 		DocumentSelector&			operator << ( const OID& value );
 
@@ -213,6 +358,27 @@ namespace mongo {
 		//! Appends ObjectId value to selector.
 		ArraySelector&		operator << ( const OID& value );
 
+		//! Appends boolean value to selector.
+		ArraySelector&		operator << ( bool value );
+
+		//! Appends numeric value to selector.
+		ArraySelector&		operator << ( int value );
+		ArraySelector&		operator << ( long value );
+		ArraySelector&		operator << ( long long value );
+		ArraySelector&		operator << ( unsigned int value );
+		ArraySelector&		operator << ( unsigned long value );
+		ArraySelector&		operator << ( unsigned long long value );
+		ArraySelector&		operator << ( double value );
+
+		//! Appends UTC datetime value to selector.
+		ArraySelector&		operator << ( const DateTime& value );
+
+		//! Appends binary value to selector.
+		ArraySelector&		operator << ( const Binary& value );
+
+		//! Appends decimal value to selector.
+		ArraySelector&		operator << ( const Decimal128& value );
+
 		//! Appends string value to selector.
 		ArraySelector&		operator << ( const char* value );
 		ArraySelector&		operator << ( const std::string& value );
@@ -225,13 +391,74 @@ namespace mongo {
 
 	private:
 
-		//! Generates a key string.
-		std::string			key( void );
+		//! Generates a key string, the string is valid until the next call.
+		const char*			key( void );
 
 	private:
 
 		//! Current array index.
 		int					m_index;
+
+		//! Key string buffer.
+		char				m_key[16];
+	};
+
+	//! A selector that is built once and rebound by patching values in place.
+	/*!
+	A selector shape is copied once, then values at dotted paths are declared as slots
+	and rebound without rebuilding a document:
+
+		PreparedSelector query( DOCUMENT( "user" << 0 << "state" << "active" ) );
+		int user = query.slot( "user" );
+		query.bind( user, 42 );
+		collection->findOne( query );
+
+	Fixed-width values (bool, int32, int64, double, datetime and ObjectId) are overwritten
+	in place, a string of a different length triggers a re-layout of the document. A slot
+	keeps its value type, binding a value of another type returns false and leaves the
+	document unchanged. Copies of a prepared selector share the same document.
+	*/
+	class PreparedSelector : public BSON {
+	public:
+
+								//! Constructs PreparedSelector instance from a selector shape.
+								PreparedSelector( const BSON& shape );
+
+		//! Declares a slot at a dotted path, returns -1 if there is no such value.
+		int						slot( const char* path );
+
+		//! Rebinds a slot value.
+		bool					bind( int slot, bool value );
+		bool					bind( int slot, int value );
+		bool					bind( int slot, int64_t value );
+		bool					bind( int slot, double value );
+		bool					bind( int slot, const OID& value );
+		bool					bind( int slot, const DateTime& value );
+		bool					bind( int slot, const char* value );
+		bool					bind( int slot, const std::string& value );
+
+	private:
+
+		//! Finds a value offset of a slot.
+		bool					resolve( const char* path, uint32_t& offset, int& type ) const;
+
+		//! Returns a pointer to a slot value if a slot has a specified type.
+		uint8_t*				value( int slot, int type ) const;
+
+		//! Rebuilds the document with a new string value of a slot.
+		void					relayout( int slot, const char* value, uint32_t length );
+
+	private:
+
+		//! Value slot.
+		struct Slot {
+			std::string			path;	//!< Dotted path of a value.
+			uint32_t			offset;	//!< Value offset in a document.
+			int					type;	//!< BSON value type.
+		};
+
+		//! Declared slots.
+		std::vector<Slot>		m_slots;
 	};
 
 } // namespace mongo
@@ -0,0 +1,136 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "Pipeline.h"
+
+namespace mongo {
+
+// ** Pipeline::Pipeline
+Pipeline::Pipeline( void ) : m_size( 0 )
+{
+
+}
+
+// ** Pipeline::match
+Pipeline& Pipeline::match( const BSON& query )
+{
+	return stage( "$match", query );
+}
+
+// ** Pipeline::project
+Pipeline& Pipeline::project( const BSON& fields )
+{
+	return stage( "$project", fields );
+}
+
+// ** Pipeline::group
+Pipeline& Pipeline::group( const BSON& spec )
+{
+	return stage( "$group", spec );
+}
+
+// ** Pipeline::group
+Pipeline& Pipeline::group( const std::string& id, const BSON& accumulators )
+{
+	BSON spec;
+	spec.set( "_id", id );
+	bson_concat( spec.raw(), accumulators.raw() );
+
+	return stage( "$group", spec );
+}
+
+// ** Pipeline::sort
+Pipeline& Pipeline::sort( const BSON& order )
+{
+	return stage( "$sort", order );
+}
+
+// ** Pipeline::skip
+Pipeline& Pipeline::skip( int64_t count )
+{
+	DocumentSelector stage;
+	stage << "$skip" << count;
+	m_stages << stage;
+	m_size++;
+
+	return *this;
+}
+
+// ** Pipeline::limit
+Pipeline& Pipeline::limit( int64_t count )
+{
+	DocumentSelector stage;
+	stage << "$limit" << count;
+	m_stages << stage;
+	m_size++;
+
+	return *this;
+}
+
+// ** Pipeline::unwind
+Pipeline& Pipeline::unwind( const std::string& path )
+{
+	DocumentSelector stage;
+	stage << "$unwind" << ( path[0] == '$' ? path : "$" + path );
+	m_stages << stage;
+	m_size++;
+
+	return *this;
+}
+
+// ** Pipeline::lookup
+Pipeline& Pipeline::lookup( const std::string& from, const std::string& localField, const std::string& foreignField, const std::string& as )
+{
+	return stage( "$lookup", DOCUMENT( "from" << from << "localField" << localField << "foreignField" << foreignField << "as" << as ) );
+}
+
+// ** Pipeline::stage
+Pipeline& Pipeline::stage( const char* name, const BSON& spec )
+{
+	DocumentSelector stage;
+	stage.setDocument( name, spec );
+	m_stages << stage;
+	m_size++;
+
+	return *this;
+}
+
+// ** Pipeline::size
+uint32_t Pipeline::size( void ) const
+{
+	return m_size;
+}
+
+// ** Pipeline::stages
+const BSON& Pipeline::stages( void ) const
+{
+	return m_stages;
+}
+
+} // namespace mongo
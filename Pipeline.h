@@ -0,0 +1,99 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_Pipeline_H__
+#define __Mongocpp_Pipeline_H__
+
+#include "MongoBson.h"
+
+namespace mongo {
+
+	//! Aggregation pipeline builder.
+	/*!
+	Stages are appended with chained calls in the order they are executed, for example:
+
+		collection->aggregate( Pipeline().match( DOCUMENT( "status" << "active" ) )
+										 .group( "$country", DOCUMENT( "total" << DOCUMENT( "$sum" << 1 ) ) )
+										 .sort( DOCUMENT( "total" << -1 ) )
+										 .limit( 10 ) );
+	*/
+	class Pipeline {
+	public:
+
+								//! Constructs an empty pipeline.
+								Pipeline( void );
+
+		//! Appends a $match stage that filters documents by a query.
+		Pipeline&				match( const BSON& query );
+
+		//! Appends a $project stage that reshapes documents.
+		Pipeline&				project( const BSON& fields );
+
+		//! Appends a $group stage with a full group specification including _id.
+		Pipeline&				group( const BSON& spec );
+
+		//! Appends a $group stage that groups documents by an expression, for example "$country".
+		Pipeline&				group( const std::string& id, const BSON& accumulators );
+
+		//! Appends a $sort stage.
+		Pipeline&				sort( const BSON& order );
+
+		//! Appends a $skip stage.
+		Pipeline&				skip( int64_t count );
+
+		//! Appends a $limit stage.
+		Pipeline&				limit( int64_t count );
+
+		//! Appends an $unwind stage that outputs a document for each element of an array field.
+		Pipeline&				unwind( const std::string& path );
+
+		//! Appends a $lookup stage that joins documents of another collection from the same database.
+		Pipeline&				lookup( const std::string& from, const std::string& localField, const std::string& foreignField, const std::string& as );
+
+		//! Appends an arbitrary stage, for example stage( "$sample", DOCUMENT( "size" << 100 ) ).
+		Pipeline&				stage( const char* name, const BSON& spec );
+
+		//! Returns the number of stages.
+		uint32_t				size( void ) const;
+
+		//! Returns pipeline stages as a BSON array.
+		const BSON&				stages( void ) const;
+
+	private:
+
+		//! Pipeline stages.
+		ArraySelector			m_stages;
+
+		//! Number of stages.
+		uint32_t				m_size;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_Pipeline_H__	*/
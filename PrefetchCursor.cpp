@@ -0,0 +1,207 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+#include "PrefetchCursor.h"
+
+#include <algorithm>
+
+namespace mongo {
+
+// ** PrefetchCursor::PrefetchCursor
+PrefetchCursor::PrefetchCursor( const CursorPtr& cursor, const Options& options )
+	: m_options( options ), m_cursor( cursor ), m_position( 0 ), m_bufferedBytes( 0 ), m_batchSize( options.initialBatchSize )
+	, m_starved( false ), m_finished( false ), m_error( false ), m_stopped( false )
+{
+	if( !m_cursor ) {
+		m_finished = true;
+		return;
+	}
+
+	mongoc_cursor_set_batch_size( m_cursor->m_cursor, m_batchSize );
+	m_thread = std::thread( &PrefetchCursor::run, this );
+}
+
+PrefetchCursor::~PrefetchCursor( void )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_stopped = true;
+	}
+
+	m_consumed.notify_all();
+
+	if( m_thread.joinable() ) {
+		m_thread.join();
+	}
+
+	release( m_current, m_position );
+
+	for( size_t i = 0; i < m_batches.size(); i++ ) {
+		release( m_batches[i], 0 );
+	}
+}
+
+// ** PrefetchCursor::release
+void PrefetchCursor::release( Batch& batch, size_t first )
+{
+	for( size_t i = first; i < batch.documents.size(); i++ ) {
+		bson_destroy( batch.documents[i] );
+	}
+
+	batch.documents.clear();
+	batch.bytes = 0;
+}
+
+// ** PrefetchCursor::batchSize
+uint32_t PrefetchCursor::batchSize( void ) const
+{
+	return m_batchSize;
+}
+
+// ** PrefetchCursor::hasError
+bool PrefetchCursor::hasError( void ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_error;
+}
+
+// ** PrefetchCursor::next
+DocumentPtr PrefetchCursor::next( void )
+{
+	if( m_position == m_current.documents.size() ) {
+		m_current.documents.clear();
+		m_position = 0;
+
+		std::unique_lock<std::mutex> lock( m_mutex );
+
+		if( m_batches.empty() && !m_finished ) {
+			m_starved = true;
+			m_produced.wait( lock, [this]() { return !m_batches.empty() || m_finished; } );
+		}
+
+		if( m_batches.empty() ) {
+			return DocumentPtr();
+		}
+
+		// Take the oldest batch, the background thread keeps filling the next one.
+		std::swap( m_current, m_batches.front() );
+		m_batches.pop_front();
+		m_bufferedBytes -= m_current.bytes;
+
+		lock.unlock();
+		m_consumed.notify_one();
+	}
+
+	bson_t* document = m_current.documents[m_position];
+	m_current.documents[m_position++] = NULL;
+
+	return DocumentPtr( new Document( document ) );
+}
+
+// ** PrefetchCursor::run
+void PrefetchCursor::run( void )
+{
+	mongoc_cursor_t* cursor = m_cursor->m_cursor;
+	const bson_t*    document;
+	Batch            batch;
+
+	while( !m_stopped && mongoc_cursor_next( cursor, &document ) ) {
+		batch.documents.push_back( bson_copy( document ) );
+		batch.bytes += document->len;
+
+		if( batch.documents.size() >= m_batchSize && !publish( batch ) ) {
+			break;
+		}
+	}
+
+	if( !m_stopped && !batch.documents.empty() ) {
+		publish( batch );
+	}
+
+	release( batch, 0 );
+
+	bson_error_t err;
+	bool         failed = mongoc_cursor_error( cursor, &err );
+
+	if( failed ) {
+		printf( "PrefetchCursor::run : %s\n", err.message );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_finished = true;
+		m_error    = failed;
+	}
+
+	m_produced.notify_all();
+}
+
+// ** PrefetchCursor::publish
+bool PrefetchCursor::publish( Batch& batch )
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	bool                         throttled = false;
+
+	// Wait for the consumer while the memory cap is reached, a single batch is always let through.
+	while( !m_stopped && !m_batches.empty() && m_bufferedBytes + batch.bytes > m_options.maxBufferedBytes ) {
+		throttled = true;
+		m_consumed.wait( lock );
+	}
+
+	if( m_stopped ) {
+		release( batch, 0 );
+		return false;
+	}
+
+	uint32_t size = m_batchSize;
+
+	// A waiting consumer means the network is the bottleneck, so larger batches amortize round trips.
+	// Hitting the memory cap means the consumer is slower, so smaller batches keep the buffer small.
+	if( m_starved ) {
+		size = std::min( size * 2, m_options.maxBatchSize );
+	} else if( throttled ) {
+		size = std::max( size / 2, m_options.minBatchSize );
+	}
+
+	m_starved = false;
+	m_bufferedBytes += batch.bytes;
+	m_batches.push_back( Batch() );
+	std::swap( m_batches.back(), batch );
+
+	lock.unlock();
+	m_produced.notify_one();
+
+	if( size != m_batchSize ) {
+		m_batchSize = size;
+		mongoc_cursor_set_batch_size( m_cursor->m_cursor, size );
+	}
+
+	return true;
+}
+
+} // namespace mongo
@@ -0,0 +1,152 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+#ifndef __Mongocpp_PrefetchCursor_H__
+#define __Mongocpp_PrefetchCursor_H__
+
+#include "Mongo.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace mongo {
+
+	typedef std::shared_ptr<class PrefetchCursor> PrefetchCursorPtr;
+
+	//! Cursor that fetches the next batch of documents on a background thread.
+	/*!
+	While the caller consumes the current batch, a background thread drives the wrapped
+	cursor and fills the next one, so network waits overlap with document processing.
+	The batch size adapts to the consumer: it grows when the consumer waits for documents
+	and shrinks when buffered documents hit the memory cap.
+
+	The wrapped cursor is used from the background thread, so the connection it came from
+	must not be used by other threads until the prefetch cursor is destroyed. A connection
+	checked out from a ConnectionPool is a natural fit.
+	*/
+	class PrefetchCursor {
+	public:
+
+		//! Prefetching options.
+		struct Options {
+								Options( void )
+									: initialBatchSize( 100 ), minBatchSize( 16 ), maxBatchSize( 8192 ), maxBufferedBytes( 16 * 1024 * 1024 ) {}
+
+			uint32_t			initialBatchSize;	//!< Batch size used for the first batch.
+			uint32_t			minBatchSize;		//!< Lower bound of an adaptive batch size.
+			uint32_t			maxBatchSize;		//!< Upper bound of an adaptive batch size.
+			size_t				maxBufferedBytes;	//!< Memory cap for documents fetched ahead.
+		};
+
+								//! Constructs PrefetchCursor instance and starts prefetching.
+								PrefetchCursor( const CursorPtr& cursor, const Options& options = Options() );
+
+								//! Stops prefetching and releases buffered documents.
+								~PrefetchCursor( void );
+
+		//! Returns the next document, blocks until it is fetched. Returns NULL at the end of a cursor.
+		DocumentPtr				next( void );
+
+		//! Returns the current batch size.
+		uint32_t				batchSize( void ) const;
+
+		//! Returns true if the wrapped cursor failed.
+		bool					hasError( void ) const;
+
+	private:
+
+		//! A batch of prefetched documents.
+		struct Batch {
+								Batch( void ) : bytes( 0 ) {}
+
+			std::vector<bson_t*>	documents;	//!< Owned document copies.
+			size_t				bytes;		//!< Total size of documents.
+		};
+
+		//! Background thread function.
+		void					run( void );
+
+		//! Hands a filled batch over to the consumer and adapts the batch size, returns false if prefetching was stopped.
+		bool					publish( Batch& batch );
+
+		//! Destroys documents that were not consumed.
+		static void				release( Batch& batch, size_t first );
+
+	private:
+
+		//! Prefetching options.
+		Options					m_options;
+
+		//! Wrapped cursor.
+		CursorPtr				m_cursor;
+
+		//! Batch that is being consumed, accessed by a consumer only.
+		Batch					m_current;
+
+		//! Position inside the current batch.
+		size_t					m_position;
+
+		//! Guards the state shared with the background thread.
+		mutable std::mutex		m_mutex;
+
+		//! Signaled when a batch is published or prefetching finishes.
+		std::condition_variable	m_produced;
+
+		//! Signaled when a batch is consumed.
+		std::condition_variable	m_consumed;
+
+		//! Published batches waiting for a consumer.
+		std::deque<Batch>		m_batches;
+
+		//! Total size of published batches.
+		size_t					m_bufferedBytes;
+
+		//! Current batch size.
+		std::atomic<uint32_t>	m_batchSize;
+
+		//! Flag indicating that the consumer waited for a batch since the last publish.
+		bool					m_starved;
+
+		//! Flag indicating that the cursor is exhausted.
+		bool					m_finished;
+
+		//! Flag indicating that the cursor failed.
+		bool					m_error;
+
+		//! Flag indicating that prefetching should stop.
+		std::atomic<bool>		m_stopped;
+
+		//! Background thread.
+		std::thread				m_thread;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_PrefetchCursor_H__	*/
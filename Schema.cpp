@@ -0,0 +1,305 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+#include "Schema.h"
+
+namespace mongo {
+
+// -------------------------------------------- SchemaCodec -------------------------------------------- //
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, bool value )
+{
+	bson_append_bool( bson, key, length, value );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, int value )
+{
+	bson_append_int32( bson, key, length, value );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, int64_t value )
+{
+	bson_append_int64( bson, key, length, value );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, double value )
+{
+	bson_append_double( bson, key, length, value );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, float value )
+{
+	bson_append_double( bson, key, length, value );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, const std::string& value )
+{
+	bson_append_utf8( bson, key, length, value.c_str(), ( int )value.length() );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, const OID& value )
+{
+	bson_append_oid( bson, key, length, value.raw() );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, const DateTime& value )
+{
+	bson_append_date_time( bson, key, length, value.milliseconds );
+}
+
+// ** SchemaCodec::encode
+void SchemaCodec::encode( bson_t* bson, const char* key, int length, const Decimal128& value )
+{
+	bson_decimal128_t decimal;
+	decimal.high = value.high;
+	decimal.low  = value.low;
+
+	bson_append_decimal128( bson, key, length, &decimal );
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, bool& value )
+{
+	if( bson_iter_type( iter ) != BSON_TYPE_BOOL ) {
+		return false;
+	}
+
+	value = bson_iter_bool( iter );
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, int& value )
+{
+	int64_t result;
+
+	// Values that don't fit a 32-bit integer are rejected instead of being truncated.
+	if( !decode( iter, result ) || result < INT32_MIN || result > INT32_MAX ) {
+		return false;
+	}
+
+	value = ( int )result;
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, int64_t& value )
+{
+	double number;
+
+	switch( bson_iter_type( iter ) ) {
+	case BSON_TYPE_INT64:	value = bson_iter_int64( iter );
+							return true;
+	case BSON_TYPE_INT32:	value = bson_iter_int32( iter );
+							return true;
+	case BSON_TYPE_DOUBLE:	number = bson_iter_double( iter );
+
+							// A NaN fails both comparisons, 2^63 is the first double above the range.
+							if( !( number >= -9223372036854775808.0 && number < 9223372036854775808.0 ) ) {
+								return false;
+							}
+
+							value = ( int64_t )number;
+							return true;
+	default:				break;
+	}
+
+	return false;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, double& value )
+{
+	switch( bson_iter_type( iter ) ) {
+	case BSON_TYPE_DOUBLE:	value = bson_iter_double( iter );
+							return true;
+	case BSON_TYPE_INT32:	value = bson_iter_int32( iter );
+							return true;
+	case BSON_TYPE_INT64:	value = ( double )bson_iter_int64( iter );
+							return true;
+	default:				break;
+	}
+
+	return false;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, float& value )
+{
+	double result;
+
+	if( !decode( iter, result ) ) {
+		return false;
+	}
+
+	value = ( float )result;
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, std::string& value )
+{
+	if( bson_iter_type( iter ) != BSON_TYPE_UTF8 ) {
+		return false;
+	}
+
+	uint32_t    length;
+	const char* str = bson_iter_utf8( iter, &length );
+	value.assign( str, length );
+
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, OID& value )
+{
+	if( bson_iter_type( iter ) != BSON_TYPE_OID ) {
+		return false;
+	}
+
+	value = OID( *bson_iter_oid( iter ) );
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, DateTime& value )
+{
+	if( bson_iter_type( iter ) != BSON_TYPE_DATE_TIME ) {
+		return false;
+	}
+
+	value = DateTime( bson_iter_date_time( iter ) );
+	return true;
+}
+
+// ** SchemaCodec::decode
+bool SchemaCodec::decode( const bson_iter_t* iter, Decimal128& value )
+{
+	bson_decimal128_t decimal;
+
+	if( !bson_iter_decimal128( iter, &decimal ) ) {
+		return false;
+	}
+
+	value.high = decimal.high;
+	value.low  = decimal.low;
+
+	return true;
+}
+
+// -------------------------------------------- SchemaBase -------------------------------------------- //
+
+// ** SchemaBase::hash
+uint64_t SchemaBase::hash( const char* key, uint32_t length )
+{
+	uint64_t result = 14695981039346656037ULL;
+
+	for( uint32_t i = 0; i < length; i++ ) {
+		result = ( result ^ ( uint8_t )key[i] ) * 1099511628211ULL;
+	}
+
+	return result;
+}
+
+// ** SchemaBase::add
+void SchemaBase::add( Field* field, const char* key, uint32_t length )
+{
+	field->key    = key;
+	field->length = length;
+	field->hash   = hash( key, length );
+	m_fields.push_back( FieldPtr( field ) );
+
+	// Keep the dispatch table at most half full.
+	size_t capacity = 8;
+	while( capacity < m_fields.size() * 2 ) {
+		capacity *= 2;
+	}
+
+	m_table.assign( capacity, -1 );
+
+	for( size_t i = 0; i < m_fields.size(); i++ ) {
+		size_t index = ( size_t )m_fields[i]->hash & ( capacity - 1 );
+
+		while( m_table[index] != -1 ) {
+			index = ( index + 1 ) & ( capacity - 1 );
+		}
+
+		m_table[index] = ( int )i;
+	}
+}
+
+// ** SchemaBase::encodeFields
+void SchemaBase::encodeFields( bson_t* bson, const void* object ) const
+{
+	for( size_t i = 0, n = m_fields.size(); i < n; i++ ) {
+		m_fields[i]->encode( bson, object );
+	}
+}
+
+// ** SchemaBase::decodeFields
+int SchemaBase::decodeFields( const DocumentView& document, void* object ) const
+{
+	int result = 0;
+
+	if( m_table.empty() ) {
+		return 0;
+	}
+
+	size_t mask = m_table.size() - 1;
+
+	for( Iter iter( document.data(), document.length() ); iter.isValid(); iter.next() ) {
+		const char* key    = iter.key();
+		uint32_t    length = bson_iter_key_len( iter.raw() );
+		uint64_t    code   = hash( key, length );
+
+		for( size_t index = ( size_t )code & mask; m_table[index] != -1; index = ( index + 1 ) & mask ) {
+			const Field* field = m_fields[m_table[index]].get();
+
+			if( field->hash != code || field->length != length || memcmp( field->key, key, length ) != 0 ) {
+				continue;
+			}
+
+			if( field->decode( iter.raw(), object ) ) {
+				result++;
+			}
+			break;
+		}
+	}
+
+	return result;
+}
+
+} // namespace mongo
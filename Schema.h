@@ -0,0 +1,188 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+#ifndef __Mongocpp_Schema_H__
+#define __Mongocpp_Schema_H__
+
+#include "MongoBson.h"
+
+namespace mongo {
+
+	//! Encodes and decodes struct field values of supported types.
+	struct SchemaCodec {
+		//! Appends a value to a BSON document, a key length is known in advance.
+		static void				encode( bson_t* bson, const char* key, int length, bool value );
+		static void				encode( bson_t* bson, const char* key, int length, int value );
+		static void				encode( bson_t* bson, const char* key, int length, int64_t value );
+		static void				encode( bson_t* bson, const char* key, int length, double value );
+		static void				encode( bson_t* bson, const char* key, int length, float value );
+		static void				encode( bson_t* bson, const char* key, int length, const std::string& value );
+		static void				encode( bson_t* bson, const char* key, int length, const OID& value );
+		static void				encode( bson_t* bson, const char* key, int length, const DateTime& value );
+		static void				encode( bson_t* bson, const char* key, int length, const Decimal128& value );
+
+		//! Reads a value from a BSON iterator, returns false if a value type doesn't match.
+		static bool				decode( const bson_iter_t* iter, bool& value );
+		static bool				decode( const bson_iter_t* iter, int& value );
+		static bool				decode( const bson_iter_t* iter, int64_t& value );
+		static bool				decode( const bson_iter_t* iter, double& value );
+		static bool				decode( const bson_iter_t* iter, float& value );
+		static bool				decode( const bson_iter_t* iter, std::string& value );
+		static bool				decode( const bson_iter_t* iter, OID& value );
+		static bool				decode( const bson_iter_t* iter, DateTime& value );
+		static bool				decode( const bson_iter_t* iter, Decimal128& value );
+	};
+
+	//! Type-independent part of a Schema.
+	class SchemaBase {
+	protected:
+
+		//! Schema field descriptor.
+		struct Field {
+			virtual				~Field( void ) {}
+
+			//! Appends a field value of an object to BSON.
+			virtual void		encode( bson_t* bson, const void* object ) const = 0;
+
+			//! Reads a field value of an object from a BSON iterator.
+			virtual bool		decode( const bson_iter_t* iter, void* object ) const = 0;
+
+			const char*			key;		//!< Field key.
+			uint32_t			length;		//!< Field key length.
+			uint64_t			hash;		//!< Field key hash.
+		};
+
+		//! Field descriptor pointer type.
+		typedef std::shared_ptr<Field> FieldPtr;
+
+		//! Registers a new field and rebuilds a dispatch table.
+		void					add( Field* field, const char* key, uint32_t length );
+
+		//! Appends all fields of an object to BSON.
+		void					encodeFields( bson_t* bson, const void* object ) const;
+
+		//! Reads object fields by walking a document once, returns the number of decoded fields.
+		int						decodeFields( const DocumentView& document, void* object ) const;
+
+		//! Calculates a key hash.
+		static uint64_t			hash( const char* key, uint32_t length );
+
+	private:
+
+		//! Registered fields in the encoding order.
+		std::vector<FieldPtr>	m_fields;
+
+		//! Open-addressing table of field indices by key hash, -1 marks free entries.
+		std::vector<int>		m_table;
+	};
+
+	//! Maps C++ struct fields to BSON documents.
+	/*!
+	Fields are registered once, for example:
+
+		static const Schema<User> schema = Schema<User>().field( "name", &User::name ).field( "age", &User::age );
+
+	Encoding appends fields with key lengths known at compile time, decoding walks a document
+	once and dispatches each key to a struct member by a key hash.
+	*/
+	template<typename T>
+	class Schema : public SchemaBase {
+	public:
+
+		//! Registers a struct field.
+		template<typename TValue, size_t N>
+		Schema&					field( const char ( &key )[N], TValue T::*member );
+
+		//! Appends struct fields to an existing BSON.
+		void					encode( BSON& bson, const T& value ) const;
+
+		//! Encodes a struct to a new BSON.
+		BSON					encode( const T& value ) const;
+
+		//! Decodes a struct from a document, returns the number of decoded fields.
+		int						decode( const DocumentView& document, T& value ) const;
+
+		//! Decodes a struct from a document, returns the number of decoded fields.
+		int						decode( const Document& document, T& value ) const;
+
+	private:
+
+		//! Field descriptor bound to a struct member.
+		template<typename TValue>
+		struct Member : public Field {
+								Member( TValue T::*member ) : member( member ) {}
+
+			virtual void		encode( bson_t* bson, const void* object ) const { SchemaCodec::encode( bson, key, length, static_cast<const T*>( object )->*member ); }
+			virtual bool		decode( const bson_iter_t* iter, void* object ) const { return SchemaCodec::decode( iter, static_cast<T*>( object )->*member ); }
+
+			TValue T::*			member;	//!< Struct member pointer.
+		};
+	};
+
+	// ** Schema::field
+	template<typename T>
+	template<typename TValue, size_t N>
+	Schema<T>& Schema<T>::field( const char ( &key )[N], TValue T::*member )
+	{
+		add( new Member<TValue>( member ), key, N - 1 );
+		return *this;
+	}
+
+	// ** Schema::encode
+	template<typename T>
+	void Schema<T>::encode( BSON& bson, const T& value ) const
+	{
+		encodeFields( bson.raw(), &value );
+	}
+
+	// ** Schema::encode
+	template<typename T>
+	BSON Schema<T>::encode( const T& value ) const
+	{
+		BSON result;
+		encode( result, value );
+		return result;
+	}
+
+	// ** Schema::decode
+	template<typename T>
+	int Schema<T>::decode( const DocumentView& document, T& value ) const
+	{
+		return decodeFields( document, &value );
+	}
+
+	// ** Schema::decode
+	template<typename T>
+	int Schema<T>::decode( const Document& document, T& value ) const
+	{
+		return decodeFields( document.view(), &value );
+	}
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_Schema_H__	*/
@@ -0,0 +1,97 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "SingleFlight.h"
+
+namespace mongo {
+
+// ** SingleFlight::SingleFlight
+SingleFlight::SingleFlight( void ) : m_executed( 0 ), m_coalesced( 0 )
+{
+
+}
+
+// ** SingleFlight::run
+DocumentPtr SingleFlight::run( const std::string& key, const Request& request )
+{
+	std::promise<DocumentPtr> promise;
+
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+
+		std::unordered_map<std::string, std::shared_future<DocumentPtr> >::iterator i = m_inFlight.find( key );
+
+		if( i != m_inFlight.end() ) {
+			std::shared_future<DocumentPtr> result = i->second;
+			lock.unlock();
+
+			m_coalesced++;
+			return result.get();
+		}
+
+		m_inFlight[key] = promise.get_future().share();
+	}
+
+	m_executed++;
+
+	DocumentPtr document;
+
+	// The key is released before waiters are woken up, so later reads start a new request.
+	try {
+		document = request();
+	}
+	catch( ... ) {
+		release( key );
+		promise.set_exception( std::current_exception() );
+		throw;
+	}
+
+	release( key );
+	promise.set_value( document );
+
+	return document;
+}
+
+// ** SingleFlight::release
+void SingleFlight::release( const std::string& key )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_inFlight.erase( key );
+}
+
+// ** SingleFlight::stats
+SingleFlight::Stats SingleFlight::stats( void ) const
+{
+	Stats stats;
+	stats.executed  = m_executed;
+	stats.coalesced = m_coalesced;
+	return stats;
+}
+
+} // namespace mongo
@@ -0,0 +1,95 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_SingleFlight_H__
+#define __Mongocpp_SingleFlight_H__
+
+#include "Mongo.h"
+
+#include <mutex>
+#include <future>
+#include <unordered_map>
+
+namespace mongo {
+
+	typedef std::shared_ptr<class SingleFlight> SingleFlightPtr;
+
+	//! Coalesces identical concurrent reads into a single request.
+	/*!
+	The first caller of a key executes a request, callers that arrive with the same key while
+	it is in flight wait for it and receive the same document instead of making their own
+	round trip. A group is shared by Collection instances of different threads, for example
+	collections of connections checked out from a ConnectionPool.
+
+	A coalesced read may return a state as of the moment the in-flight request was started.
+	Returned documents are shared between callers, so they must be treated as immutable.
+	*/
+	class SingleFlight {
+	public:
+
+		//! Executes a request.
+		typedef std::function<DocumentPtr()> Request;
+
+		//! Coalescing statistics.
+		struct Stats {
+			uint64_t			executed;	//!< Number of requests that were sent to a server.
+			uint64_t			coalesced;	//!< Number of reads that waited for an in-flight request.
+		};
+
+								//! Constructs SingleFlight instance.
+								SingleFlight( void );
+
+		//! Executes a request or waits for an in-flight request with the same key.
+		/*!
+		An exception thrown by a request is rethrown to a caller and to every waiting reader.
+		*/
+		DocumentPtr				run( const std::string& key, const Request& request );
+
+		//! Returns coalescing statistics.
+		Stats					stats( void ) const;
+
+	private:
+
+		//! Removes a finished request, so later reads start a new one.
+		void					release( const std::string& key );
+
+		//! Guards in-flight requests.
+		std::mutex				m_mutex;
+
+		//! Results of in-flight requests by key.
+		std::unordered_map<std::string, std::shared_future<DocumentPtr> >	m_inFlight;
+
+		//! Statistics counters.
+		std::atomic<uint64_t>	m_executed;
+		std::atomic<uint64_t>	m_coalesced;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_SingleFlight_H__	*/
@@ -0,0 +1,305 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "Update.h"
+
+namespace mongo {
+
+// ** Update::Update
+Update::Update( void )
+{
+
+}
+
+// ** Update::Update
+Update::Update( const Update& other )
+	: m_values( other.m_values.copy() ), m_operators( other.m_operators ), m_paths( other.m_paths ), m_error( other.m_error )
+{
+
+}
+
+// ** Update::operator =
+Update& Update::operator = ( const Update& other )
+{
+	// BSON is a shared handle, so values are copied to keep updates independent.
+	if( this != &other ) {
+		m_values    = BSON( other.m_values.copy() );
+		m_operators = other.m_operators;
+		m_paths     = other.m_paths;
+		m_error     = other.m_error;
+	}
+
+	return *this;
+}
+
+// ** Update::unset
+Update& Update::unset( const char* path )
+{
+	if( track( Unset, path ) ) {
+		m_values.set( path, "" );
+	}
+	return *this;
+}
+
+// ** Update::pushEach
+Update& Update::pushEach( const char* path, const BSON& values )
+{
+	if( track( Push, path ) ) {
+		BSON modifiers;
+		modifiers.setArray( "$each", values );
+		m_values.setDocument( path, modifiers );
+	}
+	return *this;
+}
+
+// ** Update::pushEach
+Update& Update::pushEach( const char* path, const BSON& values, int32_t slice )
+{
+	if( track( Push, path ) ) {
+		BSON modifiers;
+		modifiers.setArray( "$each", values );
+		modifiers.set( "$slice", static_cast<int>( slice ) );
+		m_values.setDocument( path, modifiers );
+	}
+	return *this;
+}
+
+// ** Update::addToSetEach
+Update& Update::addToSetEach( const char* path, const BSON& values )
+{
+	if( track( AddToSet, path ) ) {
+		BSON modifiers;
+		modifiers.setArray( "$each", values );
+		m_values.setDocument( path, modifiers );
+	}
+	return *this;
+}
+
+// ** Update::isEmpty
+bool Update::isEmpty( void ) const
+{
+	return m_operators.empty();
+}
+
+// ** Update::isValid
+bool Update::isValid( void ) const
+{
+	return m_error.empty();
+}
+
+// ** Update::error
+const std::string& Update::error( void ) const
+{
+	return m_error;
+}
+
+// ** Update::bson
+BSON Update::bson( void ) const
+{
+	BSON result;
+	bool written[TotalOperators] = { false };
+
+	// Operators are written in order of their first use, each one collects all values appended with it.
+	for( size_t i = 0, n = m_operators.size(); i < n; i++ ) {
+		Operator op = m_operators[i];
+
+		if( written[op] ) {
+			continue;
+		}
+		written[op] = true;
+
+		const char* name = operatorName( op );
+		bson_t      operand;
+		bson_iter_t value;
+		size_t      index = 0;
+
+		bson_append_document_begin( result.raw(), name, ( int )strlen( name ), &operand );
+
+		for( bson_iter_init( &value, m_values.raw() ); bson_iter_next( &value ); index++ ) {
+			if( m_operators[index] == op ) {
+				bson_append_iter( &operand, NULL, 0, &value );
+			}
+		}
+
+		bson_append_document_end( result.raw(), &operand );
+	}
+
+	return result;
+}
+
+// ** Update::operatorName
+const char* Update::operatorName( Operator op )
+{
+	static const char* names[TotalOperators] = {
+		"$set", "$unset", "$inc", "$mul", "$min", "$max", "$push", "$addToSet", "$pull"
+	};
+
+	return names[op];
+}
+
+// ** Update::track
+bool Update::track( Operator op, const char* path )
+{
+	std::string key = path ? path : "";
+
+	// ** Validate the path, the first error is kept
+	if( key.empty() || key[0] == '$' || key[0] == '.' || key[key.size() - 1] == '.' ) {
+		if( m_error.empty() ) {
+			m_error = "invalid update path '" + key + "' in " + operatorName( op );
+		}
+		return false;
+	}
+
+	for( size_t i = 0, n = m_paths.size(); i < n; i++ ) {
+		if( !overlaps( m_paths[i], key ) ) {
+			continue;
+		}
+
+		if( m_error.empty() ) {
+			m_error = "update path '" + key + "' in " + operatorName( op ) + " conflicts with '" + m_paths[i] + "'";
+		}
+		return false;
+	}
+
+	m_paths.push_back( key );
+	m_operators.push_back( op );
+
+	return true;
+}
+
+// ** Update::overlaps
+bool Update::overlaps( const std::string& a, const std::string& b )
+{
+	const std::string& shorter = a.size() < b.size() ? a : b;
+	const std::string& longer  = a.size() < b.size() ? b : a;
+
+	if( longer.compare( 0, shorter.size(), shorter ) != 0 ) {
+		return false;
+	}
+
+	return longer.size() == shorter.size() || longer[shorter.size()] == '.';
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, bool value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, int value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, long value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, long long value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, unsigned int value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, unsigned long value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, unsigned long long value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, double value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const char* value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const std::string& value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const OID& value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const DateTime& value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const Binary& value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const Decimal128& value )
+{
+	bson.set( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const BSON& value )
+{
+	bson.setDocument( key, value );
+}
+
+// ** Update::append
+void Update::append( BSON& bson, const char* key, const ArraySelector& value )
+{
+	bson.setArray( key, value );
+}
+
+} // namespace mongo
@@ -0,0 +1,259 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_Update_H__
+#define __Mongocpp_Update_H__
+
+#include "MongoBson.h"
+
+namespace mongo {
+
+	//! Update operator builder for partial document updates.
+	/*!
+	Operators are appended with chained calls and grouped into a single update document, for example:
+
+		collection->update( DOCUMENT( "_id" << id ), Update().set( "name", "Alice" )
+														  .inc( "stats.visits", 1 )
+														  .pushEach( "recent", ARRAY( "a" << "b" ), -10 ) );
+
+	Values are appended to a single owned buffer in call order, and bson() writes all operators
+	into one update document, merging repeated calls of the same operator. Each path may be
+	modified only once per update, and a path conflicts with any other path that is its parent or
+	child (for example "a" and "a.b"), as a server would reject such update anyway. Conflicts are
+	detected while the update is built, and a collection refuses to send an invalid update.
+	*/
+	class Update {
+	public:
+
+		//! Available update operators.
+		enum Operator {
+			  Set
+			, Unset
+			, Inc
+			, Mul
+			, Min
+			, Max
+			, Push
+			, AddToSet
+			, Pull
+			, TotalOperators
+		};
+
+								//! Constructs an empty update.
+								Update( void );
+
+								//! Copies an update, the copy owns its values and can be extended independently.
+								Update( const Update& other );
+
+		//! Replaces this update with a copy of another one.
+		Update&					operator = ( const Update& other );
+
+		//! Appends a $set operator that replaces a field value.
+		template<typename TValue>
+		Update&					set( const char* path, const TValue& value );
+
+		//! Appends an $unset operator that removes a field.
+		Update&					unset( const char* path );
+
+		//! Appends an $inc operator that increments a numeric field.
+		template<typename TValue>
+		Update&					inc( const char* path, const TValue& value );
+
+		//! Appends a $mul operator that multiplies a numeric field.
+		template<typename TValue>
+		Update&					mul( const char* path, const TValue& value );
+
+		//! Appends a $min operator that updates a field only if a specified value is less than the current one.
+		template<typename TValue>
+		Update&					setMin( const char* path, const TValue& value );
+
+		//! Appends a $max operator that updates a field only if a specified value is greater than the current one.
+		template<typename TValue>
+		Update&					setMax( const char* path, const TValue& value );
+
+		//! Appends a $push operator that appends a value to an array.
+		template<typename TValue>
+		Update&					push( const char* path, const TValue& value );
+
+		//! Appends a $push operator with $each modifier that appends all values from an array.
+		Update&					pushEach( const char* path, const BSON& values );
+
+		//! Appends a $push operator with $each and $slice modifiers, a negative slice keeps the last elements.
+		Update&					pushEach( const char* path, const BSON& values, int32_t slice );
+
+		//! Appends an $addToSet operator that appends a value to an array unless it is already present.
+		template<typename TValue>
+		Update&					addToSet( const char* path, const TValue& value );
+
+		//! Appends an $addToSet operator with $each modifier.
+		Update&					addToSetEach( const char* path, const BSON& values );
+
+		//! Appends a $pull operator that removes all array elements equal to a value or matching a condition.
+		template<typename TValue>
+		Update&					pull( const char* path, const TValue& value );
+
+		//! Returns true if no operators were appended.
+		bool					isEmpty( void ) const;
+
+		//! Returns true if no conflicting paths were detected.
+		bool					isValid( void ) const;
+
+		//! Returns the first detected error message.
+		const std::string&		error( void ) const;
+
+		//! Builds the update document with all appended operators in a single buffer.
+		BSON					bson( void ) const;
+
+		//! Returns the operator name.
+		static const char*		operatorName( Operator op );
+
+	private:
+
+		//! Registers a path of an operator value, returns false if the path is invalid or conflicts.
+		bool					track( Operator op, const char* path );
+
+		//! Returns true if two paths are equal or one of them is a parent of another.
+		static bool				overlaps( const std::string& a, const std::string& b );
+
+		//! Appends a typed value to an operator document.
+		static void				append( BSON& bson, const char* key, bool value );
+		static void				append( BSON& bson, const char* key, int value );
+		static void				append( BSON& bson, const char* key, long value );
+		static void				append( BSON& bson, const char* key, long long value );
+		static void				append( BSON& bson, const char* key, unsigned int value );
+		static void				append( BSON& bson, const char* key, unsigned long value );
+		static void				append( BSON& bson, const char* key, unsigned long long value );
+		static void				append( BSON& bson, const char* key, double value );
+		static void				append( BSON& bson, const char* key, const char* value );
+		static void				append( BSON& bson, const char* key, const std::string& value );
+		static void				append( BSON& bson, const char* key, const OID& value );
+		static void				append( BSON& bson, const char* key, const DateTime& value );
+		static void				append( BSON& bson, const char* key, const Binary& value );
+		static void				append( BSON& bson, const char* key, const Decimal128& value );
+		static void				append( BSON& bson, const char* key, const BSON& value );
+		static void				append( BSON& bson, const char* key, const ArraySelector& value );
+
+	private:
+
+		//! Operator values keyed by their paths in call order.
+		BSON					m_values;
+
+		//! Operators of values.
+		std::vector<Operator>	m_operators;
+
+		//! Modified paths.
+		std::vector<std::string> m_paths;
+
+		//! The first detected error.
+		std::string				m_error;
+	};
+
+	// ** Update::set
+	template<typename TValue>
+	Update& Update::set( const char* path, const TValue& value )
+	{
+		if( track( Set, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::inc
+	template<typename TValue>
+	Update& Update::inc( const char* path, const TValue& value )
+	{
+		if( track( Inc, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::mul
+	template<typename TValue>
+	Update& Update::mul( const char* path, const TValue& value )
+	{
+		if( track( Mul, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::setMin
+	template<typename TValue>
+	Update& Update::setMin( const char* path, const TValue& value )
+	{
+		if( track( Min, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::setMax
+	template<typename TValue>
+	Update& Update::setMax( const char* path, const TValue& value )
+	{
+		if( track( Max, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::push
+	template<typename TValue>
+	Update& Update::push( const char* path, const TValue& value )
+	{
+		if( track( Push, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::addToSet
+	template<typename TValue>
+	Update& Update::addToSet( const char* path, const TValue& value )
+	{
+		if( track( AddToSet, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+	// ** Update::pull
+	template<typename TValue>
+	Update& Update::pull( const char* path, const TValue& value )
+	{
+		if( track( Pull, path ) ) {
+			append( m_values, path, value );
+		}
+		return *this;
+	}
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_Update_H__	*/
@@ -0,0 +1,296 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#include "WriteBuffer.h"
+#include "Collection.h"
+
+#include <chrono>
+
+namespace mongo {
+
+// ** WriteBuffer::Node::Node
+WriteBuffer::Node::Node( WriteType type, bson_t* query, bson_t* document, const Callback& callback )
+	: next( NULL ), type( type ), query( query ), document( document ), bytes( 0 ), callback( callback )
+{
+	bytes += query    ? query->len    : 0;
+	bytes += document ? document->len : 0;
+}
+
+// ** WriteBuffer::WriteBuffer
+WriteBuffer::WriteBuffer( const CollectionPtr& collection, const Options& options )
+	: m_collection( collection ), m_options( options ), m_head( NULL ), m_tail( NULL ), m_pushed( 0 ), m_pendingCount( 0 ), m_pendingBytes( 0 )
+	, m_closed( false ), m_flushTarget( 0 ), m_executed( 0 ), m_stopping( false )
+{
+	// The queue always holds a stub node, so producers never touch the consumer end.
+	m_tail = new Node;
+	m_head = m_tail;
+
+	m_thread = std::thread( &WriteBuffer::run, this );
+}
+
+WriteBuffer::~WriteBuffer( void )
+{
+	close();
+
+	// Writes that were pushed while the buffer was closing are rejected.
+	while( Node* node = pop() ) {
+		if( node->callback ) {
+			node->callback( false );
+		}
+		delete node;
+	}
+
+	delete m_tail;
+}
+
+// ** WriteBuffer::insert
+bool WriteBuffer::insert( const BSON& document, const Callback& callback )
+{
+	return push( new Node( WriteInsert, NULL, document.copy(), callback ) );
+}
+
+// ** WriteBuffer::upsert
+bool WriteBuffer::upsert( const BSON& query, const BSON& update, const Callback& callback )
+{
+	return push( new Node( WriteUpsert, query.copy(), update.copy(), callback ) );
+}
+
+// ** WriteBuffer::update
+bool WriteBuffer::update( const BSON& query, const BSON& update, const Callback& callback )
+{
+	return push( new Node( WriteUpdate, query.copy(), update.copy(), callback ) );
+}
+
+// ** WriteBuffer::remove
+bool WriteBuffer::remove( const BSON& query, const Callback& callback )
+{
+	return push( new Node( WriteRemove, query.copy(), NULL, callback ) );
+}
+
+// ** WriteBuffer::push
+bool WriteBuffer::push( Node* node )
+{
+	if( m_closed ) {
+		if( node->callback ) {
+			node->callback( false );
+		}
+		delete node;
+		return false;
+	}
+
+	size_t   bytes = node->bytes;
+	uint32_t count = ++m_pendingCount;
+	size_t   total = m_pendingBytes += bytes;
+
+	// Swap the head first and link the previous node after, the node may be popped as soon as it is linked.
+	Node* previous = m_head.exchange( node, std::memory_order_acq_rel );
+	previous->next.store( node, std::memory_order_release );
+	m_pushed++;
+
+	// Wake up a flush thread only when a threshold is crossed, a missed wakeup is covered by the flush timeout.
+	if( count == m_options.maxCount || ( total >= m_options.maxBytes && total - bytes < m_options.maxBytes ) ) {
+		m_wakeup.notify_one();
+	}
+
+	return true;
+}
+
+// ** WriteBuffer::pop
+WriteBuffer::Node* WriteBuffer::pop( void )
+{
+	Node* tail = m_tail;
+	Node* next = tail->next.load( std::memory_order_acquire );
+
+	if( next == NULL ) {
+		return NULL;
+	}
+
+	// The next node becomes a new stub, so its payload moves to the released stub.
+	std::swap( tail->type, next->type );
+	std::swap( tail->query, next->query );
+	std::swap( tail->document, next->document );
+	std::swap( tail->bytes, next->bytes );
+	std::swap( tail->callback, next->callback );
+	m_tail = next;
+
+	m_pendingCount--;
+	m_pendingBytes -= tail->bytes;
+
+	return tail;
+}
+
+// ** WriteBuffer::flush
+void WriteBuffer::flush( void )
+{
+	uint64_t target = m_pushed;
+
+	std::unique_lock<std::mutex> lock( m_mutex );
+
+	if( m_stopping ) {
+		return;
+	}
+
+	m_flushTarget = std::max( m_flushTarget, target );
+	m_wakeup.notify_one();
+	m_flushed.wait( lock, [this, target]() { return m_executed >= target; } );
+}
+
+// ** WriteBuffer::close
+void WriteBuffer::close( void )
+{
+	if( m_closed.exchange( true ) ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_stopping = true;
+	}
+
+	m_wakeup.notify_one();
+	m_thread.join();
+
+	// Execute writes that were queued while the flush thread was stopping.
+	size_t executed = 0;
+
+	for( size_t count = drain(); count; count = drain() ) {
+		executed += count;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_executed += executed;
+	}
+
+	m_flushed.notify_all();
+}
+
+// ** WriteBuffer::run
+void WriteBuffer::run( void )
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+
+	while( true ) {
+		m_wakeup.wait_for( lock, std::chrono::milliseconds( m_options.maxDelayMs ), [this]() {
+			return m_stopping || m_executed < m_flushTarget || m_pendingCount >= m_options.maxCount || m_pendingBytes >= m_options.maxBytes;
+		} );
+
+		bool stopping = m_stopping;
+		lock.unlock();
+
+		size_t executed = 0;
+
+		for( size_t count = drain(); count; count = drain() ) {
+			executed += count;
+		}
+
+		lock.lock();
+		m_executed += executed;
+
+		if( executed ) {
+			m_flushed.notify_all();
+		}
+
+		if( stopping ) {
+			break;
+		}
+
+		// A producer is between swapping the head and linking a node, let it finish.
+		if( !executed && m_executed < m_flushTarget ) {
+			lock.unlock();
+			std::this_thread::yield();
+			lock.lock();
+		}
+	}
+}
+
+// ** WriteBuffer::drain
+size_t WriteBuffer::drain( void )
+{
+	std::vector<Node*> nodes;
+
+	while( nodes.size() < m_options.maxCount ) {
+		Node* node = pop();
+
+		if( node == NULL ) {
+			break;
+		}
+
+		nodes.push_back( node );
+	}
+
+	if( nodes.empty() ) {
+		return 0;
+	}
+
+	BulkOperationPtr bulk = m_collection->createBulkOperation( false, m_options.writeConcern );
+
+	for( size_t i = 0; i < nodes.size(); i++ ) {
+		const Node* node = nodes[i];
+
+		// Updates match a single document and replacements are dispatched by a bulk operation, as Collection does.
+		switch( node->type ) {
+		case WriteInsert:	bulk->insert( node->document );
+							break;
+		case WriteUpsert:	bulk->upsert( node->query, node->document );
+							break;
+		case WriteUpdate:	bulk->update( node->query, node->document );
+							break;
+		case WriteRemove:	bulk->removeMany( node->query );
+							break;
+		}
+	}
+
+	BulkResult result;
+	bool       success = bulk->execute( &result );
+
+	// Without write errors a failed bulk operation failed as a whole, e.g. due to a network error.
+	std::vector<bool> failed( nodes.size(), !success && result.writeErrors.empty() );
+
+	if( !success && result.writeErrors.empty() ) {
+		printf( "WriteBuffer::drain : %s\n", result.error.c_str() );
+	}
+
+	for( size_t i = 0; i < result.writeErrors.size(); i++ ) {
+		if( result.writeErrors[i].index < nodes.size() ) {
+			failed[result.writeErrors[i].index] = true;
+		}
+	}
+
+	for( size_t i = 0; i < nodes.size(); i++ ) {
+		if( nodes[i]->callback ) {
+			nodes[i]->callback( !failed[i] );
+		}
+		delete nodes[i];
+	}
+
+	return nodes.size();
+}
+
+} // namespace mongo
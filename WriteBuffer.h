@@ -0,0 +1,189 @@
+/**************************************************************************
+ 
+ The MIT License (MIT)
+
+ Copyright (c) 2015 Dmitry Sovetov
+
+ https://github.com/dmsovetov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+ **************************************************************************/
+
+
+#ifndef __Mongocpp_WriteBuffer_H__
+#define __Mongocpp_WriteBuffer_H__
+
+#include "Mongo.h"
+#include "MongoBson.h"
+
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+namespace mongo {
+
+	typedef std::shared_ptr<class WriteBuffer> WriteBufferPtr;
+
+	//! Write-behind buffer that coalesces single writes into bulk operations.
+	/*!
+	Writes are accepted from any thread without locking: each write is pushed to a
+	multiple-producer single-consumer queue and a background thread flushes queued
+	writes as unordered bulk operations once a count, byte size or time threshold is
+	reached. Each write can be given a callback that is invoked from the flush thread
+	with the outcome of that write.
+
+	The collection is used from the flush thread, so it must not be used by other
+	threads while the buffer is open. A collection from a dedicated connection or from a
+	connection checked out from a ConnectionPool is a natural fit.
+	*/
+	class WriteBuffer {
+	public:
+
+		//! Write completion callback, receives true if the write succeeded.
+		typedef std::function<void( bool )> Callback;
+
+		//! Flushing thresholds.
+		struct Options {
+								Options( void )
+									: maxCount( 1000 ), maxBytes( 4 * 1024 * 1024 ), maxDelayMs( 10 ) {}
+
+			uint32_t			maxCount;		//!< Number of queued writes that triggers a flush, also a maximum bulk operation size.
+			size_t				maxBytes;		//!< Total size of queued documents that triggers a flush.
+			uint32_t			maxDelayMs;		//!< Maximum time a write stays queued.
+			WriteConcern		writeConcern;	//!< Write concern of flushed bulk operations, unacknowledged writes always report success.
+		};
+
+								//! Constructs WriteBuffer instance and starts a flush thread.
+								WriteBuffer( const CollectionPtr& collection, const Options& options = Options() );
+
+								//! Closes the buffer.
+								~WriteBuffer( void );
+
+		//! Queues a document insertion, returns false if the buffer is closed.
+		bool					insert( const BSON& document, const Callback& callback = Callback() );
+
+		//! Queues an update of the first matching document, a document is inserted if nothing matches.
+		/*!
+		Like Collection::upsert, accepts both update operator documents and replacement documents.
+		*/
+		bool					upsert( const BSON& query, const BSON& update, const Callback& callback = Callback() );
+
+		//! Queues an update of the first matching document.
+		/*!
+		Like Collection::update, accepts both update operator documents and replacement documents.
+		*/
+		bool					update( const BSON& query, const BSON& update, const Callback& callback = Callback() );
+
+		//! Queues a removal of all matching documents.
+		bool					remove( const BSON& query, const Callback& callback = Callback() );
+
+		//! Blocks until all writes queued before this call are executed.
+		void					flush( void );
+
+		//! Flushes queued writes and stops the flush thread, writes made after closing are rejected.
+		void					close( void );
+
+	private:
+
+		//! Queued write type.
+		enum WriteType {
+			WriteInsert,
+			WriteUpsert,
+			WriteUpdate,
+			WriteRemove
+		};
+
+		//! Queue node.
+		struct Node {
+								//! Constructs a queue node, takes ownership of documents.
+								Node( WriteType type = WriteInsert, bson_t* query = NULL, bson_t* document = NULL, const Callback& callback = Callback() );
+
+			std::atomic<Node*>	next;		//!< Next queued node.
+			WriteType			type;		//!< Write type.
+			BSON				query;		//!< Query document.
+			BSON				document;	//!< Inserted document or an update.
+			size_t				bytes;		//!< Total size of documents.
+			Callback			callback;	//!< Completion callback.
+		};
+
+		//! Pushes a write to the queue, can be called from any thread.
+		bool					push( Node* node );
+
+		//! Pops the oldest write from the queue, can be called from a flush thread only.
+		Node*					pop( void );
+
+		//! Flush thread function.
+		void					run( void );
+
+		//! Executes up to maxCount queued writes as a single bulk operation, returns the number of executed writes.
+		size_t					drain( void );
+
+	private:
+
+		//! Target collection.
+		CollectionPtr			m_collection;
+
+		//! Flushing thresholds.
+		Options					m_options;
+
+		//! Queue head, producers append nodes here.
+		std::atomic<Node*>		m_head;
+
+		//! Queue tail, a stub node which next node is the oldest write.
+		Node*					m_tail;
+
+		//! Number of writes pushed to the queue.
+		std::atomic<uint64_t>	m_pushed;
+
+		//! Number of queued writes that are not executed yet.
+		std::atomic<uint32_t>	m_pendingCount;
+
+		//! Total size of queued documents.
+		std::atomic<size_t>		m_pendingBytes;
+
+		//! Flag indicating that writes are rejected.
+		std::atomic<bool>		m_closed;
+
+		//! Guards the flush thread state.
+		std::mutex				m_mutex;
+
+		//! Signaled when a flush thread should wake up.
+		std::condition_variable	m_wakeup;
+
+		//! Signaled when queued writes are executed.
+		std::condition_variable	m_flushed;
+
+		//! Number of writes that should be executed before a flush thread goes to sleep.
+		uint64_t				m_flushTarget;
+
+		//! Number of executed writes.
+		uint64_t				m_executed;
+
+		//! Flag indicating that a flush thread should exit.
+		bool					m_stopping;
+
+		//! Flush thread.
+		std::thread				m_thread;
+	};
+
+} // namespace mongo
+
+#endif	/*	!__Mongocpp_WriteBuffer_H__	*/